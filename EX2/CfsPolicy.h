@@ -0,0 +1,78 @@
+#ifndef _CFS_POLICY_H_
+#define _CFS_POLICY_H_
+
+#include <stdint.h>
+#include "Thread.h"
+#include "ThreadHeap.h"
+
+/**
+ * @brief Fair-share scheduling after Linux's CFS: the READY thread with the lowest virtual runtime runs next.
+ *
+ * A thread's virtual runtime grows with the time it actually runs (Thread::runtime, measured at every switch),
+ * scaled by UTHREAD_DEFAULT_WEIGHT / its weight, so over time every thread gets CPU in proportion to its weight
+ * (uthread_set_weight). A thread that becomes READY after waiting is moved up to min_vruntime, the virtual time
+ * of the queue, so it cannot bank the time it did not use and then monopolise the CPU; a new thread starts there.
+ *
+ * The queue is a min-heap on virtual runtime (ThreadHeap). Every thread remembers its slot (Thread::cfs_index), so
+ * a blocked or terminated thread is taken out in O(log n).
+ */
+class CfsPolicy {
+private:
+    static bool before(const Thread *a, const Thread *b) {
+        return a->vruntime < b->vruntime;
+    }
+
+    ThreadHeap<&CfsPolicy::before, &Thread::cfs_index> heap;
+    uint64_t min_vruntime;
+
+public:
+    static const bool work_stealing = false;
+
+    CfsPolicy() : min_vruntime(0) {}
+
+    /**
+     * @brief Reserves room for capacity threads, so enqueue never allocates afterwards.
+     */
+    void reserve(int capacity) {
+        heap.reserve(capacity);
+    }
+
+    void enqueue(Thread *thread) {
+        if (thread->vruntime < min_vruntime) {
+            thread->vruntime = min_vruntime;
+        }
+        heap.push(thread);
+    }
+
+    Thread *dequeue() {
+        Thread *thread = heap.pop();
+        if (thread == nullptr) {
+            return nullptr;
+        }
+        if (thread->vruntime > min_vruntime) {
+            min_vruntime = thread->vruntime;
+        }
+        return thread;
+    }
+
+    bool erase(Thread *thread) {
+        return heap.erase(thread);
+    }
+
+    /**
+     * @brief Adds the time the thread ran since it was last charged to its virtual runtime.
+     */
+    void stopped(Thread *thread, bool) {
+        uint64_t ran = thread->runtime - thread->vruntime_charged;
+        thread->vruntime_charged = thread->runtime;
+        thread->vruntime += ran * UTHREAD_DEFAULT_WEIGHT / thread->weight;
+    }
+
+    void new_quantum(int) {}
+
+    uint64_t slice(const Thread *) const {
+        return 0;
+    }
+};
+
+#endif //_CFS_POLICY_H_
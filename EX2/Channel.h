@@ -0,0 +1,71 @@
+#ifndef _CHANNEL_H_
+#define _CHANNEL_H_
+
+#include <stddef.h>
+#include <string.h>
+#include "Thread.h"
+#include "ReadyQueue.h"
+
+/**
+ * @brief Bounded FIFO of fixed-size elements between uthreads, behind uthread_chan_t.
+ *
+ * The elements sit in a ring buffer of capacity slots (none for an unbuffered channel). Threads that cannot
+ * complete an operation park on the channel, in senders or receivers, with Thread::transfer pointing at their
+ * element: the thread that completes the operation copies the element straight from or to it, so a parked thread
+ * has nothing left to do once it runs again. Only the scheduler's side (who parks, who is handed the CPU) lives in
+ * uthreads.cpp.
+ */
+class Channel {
+private:
+    size_t elem_size;
+    int capacity;
+    char *buffer;
+    int head;
+    int count;
+
+public:
+    ReadyQueue senders;
+    ReadyQueue receivers;
+
+    Channel(size_t elem_size, int capacity) : elem_size(elem_size), capacity(capacity),
+            buffer(new char[elem_size * (capacity > 0 ? capacity : 1)]), head(0), count(0) {}
+
+    ~Channel() {
+        delete[] buffer;
+    }
+
+    bool empty() const {
+        return count == 0;
+    }
+
+    bool full() const {
+        return count == capacity;
+    }
+
+    /**
+     * @brief Appends a copy of elem. The buffer must not be full.
+     */
+    void push(const void *elem) {
+        int tail = head + count < capacity ? head + count : head + count - capacity;
+        memcpy(buffer + (size_t) tail * elem_size, elem, elem_size);
+        count++;
+    }
+
+    /**
+     * @brief Moves the oldest element to elem. The buffer must not be empty.
+     */
+    void pop(void *elem) {
+        memcpy(elem, buffer + (size_t) head * elem_size, elem_size);
+        head = head + 1 < capacity ? head + 1 : 0;
+        count--;
+    }
+
+    /**
+     * @brief Copies an element between two threads' buffers, bypassing the ring.
+     */
+    void copy(void *to, const void *from) const {
+        memcpy(to, from, elem_size);
+    }
+};
+
+#endif //_CHANNEL_H_
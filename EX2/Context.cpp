@@ -0,0 +1,82 @@
+#include <stdint.h>
+#include "Context.h"
+
+#ifdef __x86_64__
+
+#define CONTEXT_STACK_ALIGN 16
+#define CONTEXT_MXCSR_DEFAULT 0x1F80
+#define CONTEXT_FPUCW_DEFAULT 0x037F
+
+/* Layout of a saved context, from Context::sp upwards. It must match the push/pop order below. */
+struct SavedFrame {
+    uint32_t mxcsr;
+    uint16_t fpucw;
+    uint16_t padding;
+    uint64_t r15;
+    uint64_t r14;
+    uint64_t r13;
+    uint64_t r12;
+    uint64_t rbx;
+    uint64_t rbp;
+    uint64_t ret;
+};
+
+asm(
+    ".text\n"
+    ".globl context_switch\n"
+    ".type context_switch, @function\n"
+    "context_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq (%rsi), %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size context_switch, .-context_switch\n"
+    "\n"
+    /* First return of a fresh context lands here with the start routine in rbx and an aligned rsp. */
+    ".globl context_trampoline\n"
+    ".type context_trampoline, @function\n"
+    "context_trampoline:\n"
+    "    xorl %ebp, %ebp\n"
+    "    callq *%rbx\n"
+    "    ud2\n"
+    ".size context_trampoline, .-context_trampoline\n"
+);
+
+extern "C" void context_trampoline(void);
+
+void context_init(Context *ctx, char *stack, size_t stack_size, void (*start)(void)) {
+    uintptr_t top = ((uintptr_t) stack + stack_size) & ~(uintptr_t) (CONTEXT_STACK_ALIGN - 1);
+    // after "ret" pops the trampoline address, rsp must be 16-byte aligned for its call
+    top -= CONTEXT_STACK_ALIGN;
+    SavedFrame *frame = (SavedFrame *) (top - sizeof(SavedFrame));
+    frame->mxcsr = CONTEXT_MXCSR_DEFAULT;
+    frame->fpucw = CONTEXT_FPUCW_DEFAULT;
+    frame->padding = 0;
+    frame->r15 = 0;
+    frame->r14 = 0;
+    frame->r13 = 0;
+    frame->r12 = 0;
+    frame->rbx = (uint64_t) start;
+    frame->rbp = 0;
+    frame->ret = (uint64_t) context_trampoline;
+    ctx->sp = frame;
+}
+
+#endif
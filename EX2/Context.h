@@ -0,0 +1,39 @@
+#ifndef _CONTEXT_H_
+#define _CONTEXT_H_
+
+#include <stddef.h>
+
+/* The hand-written switch is used on x86-64 unless the jmpbuf path is requested at build time
+   (-DUTHREADS_JMPBUF_SWITCH). Other architectures always use sigsetjmp/siglongjmp. */
+#if defined(__x86_64__) && !defined(UTHREADS_JMPBUF_SWITCH)
+#define UTHREADS_ASM_SWITCH
+#endif
+
+/**
+ * @brief Execution context of a switched-out thread.
+ *
+ * Only the stack pointer is kept here; the callee-saved registers (rbx, rbp, r12-r15) and the MXCSR / x87
+ * control words are pushed on the thread's own stack by context_switch. The signal mask is not part of the
+ * context - it is the caller's business.
+ */
+typedef struct Context {
+    void *sp;
+} Context;
+
+#ifdef __x86_64__
+/**
+ * @brief Saves the running context into from and resumes to.
+ *
+ * Returns when some other context switches back to from. No system call is made.
+ */
+extern "C" void context_switch(Context *from, Context *to);
+
+/**
+ * @brief Prepares ctx so that switching to it runs start() on the given stack.
+ *
+ * start must never return.
+ */
+void context_init(Context *ctx, char *stack, size_t stack_size, void (*start)(void));
+#endif
+
+#endif //_CONTEXT_H_
@@ -0,0 +1,73 @@
+#ifndef _EDF_POLICY_H_
+#define _EDF_POLICY_H_
+
+#include <stdint.h>
+#include "Thread.h"
+#include "ThreadHeap.h"
+#include "ReadyQueue.h"
+
+/**
+ * @brief Earliest deadline first, for real-time threads (uthread_set_deadline): of the READY real-time threads
+ * that have budget left in their current job, the one whose job is due first runs next.
+ *
+ * A job may run ahead of the others for its budget only: once it used that up (Thread::runtime since the job was
+ * released) it waits in the background queue with the ordinary threads, in FIFO order, until it ends and the next
+ * job brings a fresh budget. So an overrunning job cannot push every later deadline back, and ordinary threads
+ * still run whenever no job with budget is READY. The scheduler arms the quantum timer to fire when the budget of
+ * the thread it switches to runs out (see slice), so the budget holds within a quantum.
+ *
+ * The deadline queue is a min-heap (ThreadHeap); every thread remembers its slot (Thread::edf_index), so a blocked
+ * or terminated thread is taken out in O(log n).
+ */
+class EdfPolicy {
+private:
+    static bool before(const Thread *a, const Thread *b) {
+        return a->deadline < b->deadline;
+    }
+
+    ThreadHeap<&EdfPolicy::before, &Thread::edf_index> heap;
+    ReadyQueue background;
+
+public:
+    static const bool work_stealing = false;
+
+    /**
+     * @brief Reserves room for capacity threads, so enqueue never allocates afterwards.
+     */
+    void reserve(int capacity) {
+        heap.reserve(capacity);
+    }
+
+    void enqueue(Thread *thread) {
+        if (thread->budget_left() == 0) {
+            background.push_back(thread);
+            return;
+        }
+        heap.push(thread);
+    }
+
+    Thread *dequeue() {
+        if (!heap.empty()) {
+            return heap.pop();
+        }
+        return background.pop_front();
+    }
+
+    bool erase(Thread *thread) {
+        return heap.erase(thread) || background.erase(thread);
+    }
+
+    void stopped(Thread *, bool) {}
+
+    void new_quantum(int) {}
+
+    /**
+     * @brief How long thread may run before it must be preempted: what is left of its job's budget, or 0 (a
+     * quantum) if it has none left or is not real-time.
+     */
+    uint64_t slice(const Thread *thread) const {
+        return thread->budget_left();
+    }
+};
+
+#endif //_EDF_POLICY_H_
@@ -0,0 +1,44 @@
+#ifndef _FIFO_POLICY_H_
+#define _FIFO_POLICY_H_
+
+#include <stdint.h>
+#include "Thread.h"
+#include "ReadyQueue.h"
+
+/**
+ * @brief Round-robin scheduling: READY threads run in the order they became READY, one quantum each.
+ *
+ * The library's original policy, and the default. With several workers it is the only policy that runs on the
+ * per-worker work-stealing deques, which are FIFO as well (see RunQueue).
+ */
+class FifoPolicy {
+private:
+    ReadyQueue queue;
+
+public:
+    static const bool work_stealing = true;
+
+    void reserve(int) {}
+
+    void enqueue(Thread *thread) {
+        queue.push_back(thread);
+    }
+
+    Thread *dequeue() {
+        return queue.pop_front();
+    }
+
+    bool erase(Thread *thread) {
+        return queue.erase(thread);
+    }
+
+    void stopped(Thread *, bool) {}
+
+    void new_quantum(int) {}
+
+    uint64_t slice(const Thread *) const {
+        return 0;
+    }
+};
+
+#endif //_FIFO_POLICY_H_
@@ -0,0 +1,400 @@
+#ifndef _FILE_IO_H_
+#define _FILE_IO_H_
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <vector>
+#include "Thread.h"
+
+#define FILE_IO_ENTRIES 256 /* submission ring size */
+#define FILE_IO_THREADS 16  /* kernel threads of the fallback pool */
+#define FILE_IO_MAX_COUNT 0x7ffff000 /* most bytes one read or write transfers on Linux */
+
+/**
+ * @brief A file read or write (uthread_pread/uthread_pwrite) handed to the kernel. It lives on the stack of the
+ * thread that waits for it; the request holds a queue entry of that thread (see Thread::add_entry), so a thread
+ * terminated meanwhile, with its stack, is only freed once the request completes.
+ */
+struct FileRequest {
+    Thread *thread;
+    bool write;
+    int fd;
+    void *buf;
+    size_t count;
+    off_t offset;
+    ssize_t result; // as returned by pread/pwrite, or -errno
+    FileRequest *next; // fallback pool queues
+};
+
+/**
+ * @brief Asynchronous file I/O for the scheduler: threads submit a FileRequest and park, and the completions are
+ * harvested in batches, wherever the scheduler polls the I/O reactor.
+ *
+ * Requests go to an io_uring, set up with raw system calls (no liburing). Submissions are queued in the
+ * submission ring and handed to the kernel in one io_uring_enter when the completions are next harvested, so the
+ * threads that park one after the other within a quantum share a system call. Where io_uring is missing (before
+ * Linux 5.6, which brought IORING_OP_READ/WRITE, or disabled), or with -DUTHREADS_FILE_IO_THREADS, a pool of
+ * FILE_IO_THREADS kernel threads runs pread/pwrite instead and reports completions through an eventfd. Either way
+ * fd() becomes readable when completions are pending, so an idle worker can sleep on it.
+ *
+ * Everything but the pool threads runs inside the library, under the scheduler lock; harvest may run in the timer
+ * handler, on a thread's small stack.
+ */
+class FileIo {
+private:
+    bool tried;
+    bool opened;
+    int in_flight;
+
+    // io_uring: the ring descriptor, and the rings shared with the kernel
+    int ring_fd;
+    void *sq_map;
+    size_t sq_map_size;
+    void *cq_map;
+    size_t cq_map_size;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned *sq_flags;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    struct io_uring_cqe *cqes;
+    unsigned cq_mask;
+    unsigned unsubmitted;
+
+    // fallback pool: requests waiting for a pool thread, and completed ones waiting for harvest
+    int event_fd;
+    std::vector<pthread_t> pool;
+    pthread_mutex_t lock;
+    pthread_cond_t queued;
+    FileRequest *pending;
+    FileRequest **pending_tail;
+    FileRequest *completed;
+    bool stopping;
+
+    bool open_ring() {
+        struct io_uring_params params = {};
+        ring_fd = (int) syscall(__NR_io_uring_setup, FILE_IO_ENTRIES, &params);
+        if (ring_fd < 0) {
+            return false;
+        }
+        if ((params.features & IORING_FEAT_RW_CUR_POS) == 0) {
+            // older than 5.6: no IORING_OP_READ/WRITE
+            close_ring();
+            return false;
+        }
+        sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sq_map_size = cq_map_size = sq_map_size > cq_map_size ? sq_map_size : cq_map_size;
+        }
+        sq_map = mmap(NULL, sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                      IORING_OFF_SQ_RING);
+        if (sq_map == MAP_FAILED) {
+            sq_map = nullptr;
+            close_ring();
+            return false;
+        }
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cq_map = sq_map;
+        } else {
+            cq_map = mmap(NULL, cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                          IORING_OFF_CQ_RING);
+        }
+        sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        void *sqes_map = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                              IORING_OFF_SQES);
+        if (cq_map == MAP_FAILED || sqes_map == MAP_FAILED) {
+            cq_map = cq_map == MAP_FAILED ? nullptr : cq_map;
+            sqes = sqes_map == MAP_FAILED ? nullptr : (struct io_uring_sqe *) sqes_map;
+            close_ring();
+            return false;
+        }
+        char *sq = (char *) sq_map;
+        char *cq = (char *) cq_map;
+        sqes = (struct io_uring_sqe *) sqes_map;
+        sq_head = (unsigned *) (sq + params.sq_off.head);
+        sq_tail = (unsigned *) (sq + params.sq_off.tail);
+        sq_array = (unsigned *) (sq + params.sq_off.array);
+        sq_flags = (unsigned *) (sq + params.sq_off.flags);
+        sq_mask = *(unsigned *) (sq + params.sq_off.ring_mask);
+        sq_entries = params.sq_entries;
+        cq_head = (unsigned *) (cq + params.cq_off.head);
+        cq_tail = (unsigned *) (cq + params.cq_off.tail);
+        cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+        cq_mask = *(unsigned *) (cq + params.cq_off.ring_mask);
+        return true;
+    }
+
+    void close_ring() {
+        if (sqes != nullptr) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_map != nullptr && cq_map != sq_map) {
+            munmap(cq_map, cq_map_size);
+        }
+        if (sq_map != nullptr) {
+            munmap(sq_map, sq_map_size);
+        }
+        close(ring_fd);
+        ring_fd = -1;
+        sqes = nullptr;
+        sq_map = cq_map = nullptr;
+    }
+
+    /**
+     * @brief Hands the queued submissions to the kernel.
+     *
+     * @return false if the kernel took none of them.
+     */
+    bool flush() {
+        while (unsubmitted > 0) {
+            long ret = syscall(__NR_io_uring_enter, ring_fd, unsubmitted, 0, 0, NULL, 0);
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+            if (ret <= 0) {
+                return false;
+            }
+            unsubmitted -= (unsigned) ret;
+        }
+        return true;
+    }
+
+    bool submit_ring(FileRequest *request) {
+        unsigned tail = *sq_tail;
+        if (tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= sq_entries && !flush()) {
+            return false;
+        }
+        unsigned index = tail & sq_mask;
+        struct io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = request->write ? IORING_OP_WRITE : IORING_OP_READ;
+        sqe->fd = request->fd;
+        sqe->addr = (uint64_t) (uintptr_t) request->buf;
+        sqe->len = (uint32_t) request->count;
+        sqe->off = (uint64_t) request->offset;
+        sqe->user_data = (uint64_t) (uintptr_t) request;
+        sq_array[index] = index;
+        __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+        unsubmitted++;
+        return true;
+    }
+
+    template <class Complete>
+    int harvest_ring(Complete complete) {
+        flush();
+        int count = 0;
+        while (true) {
+            unsigned head = *cq_head;
+            unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; head++, count++) {
+                struct io_uring_cqe *cqe = &cqes[head & cq_mask];
+                FileRequest *request = (FileRequest *) (uintptr_t) cqe->user_data;
+                request->result = cqe->res;
+                complete(request);
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+            // more completions than the ring holds: the kernel keeps the rest until asked for them
+            if ((__atomic_load_n(sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) == 0 ||
+                syscall(__NR_io_uring_enter, ring_fd, 0, 0, IORING_ENTER_GETEVENTS, NULL, 0) < 0) {
+                return count;
+            }
+        }
+    }
+
+    static void *pool_main(void *arg) {
+        FileIo *io = (FileIo *) arg;
+        pthread_mutex_lock(&io->lock);
+        while (true) {
+            while (io->pending == nullptr && !io->stopping) {
+                pthread_cond_wait(&io->queued, &io->lock);
+            }
+            if (io->stopping) {
+                break;
+            }
+            FileRequest *request = io->pending;
+            io->pending = request->next;
+            if (io->pending == nullptr) {
+                io->pending_tail = &io->pending;
+            }
+            pthread_mutex_unlock(&io->lock);
+            ssize_t ret = request->write ? pwrite(request->fd, request->buf, request->count, request->offset)
+                                         : pread(request->fd, request->buf, request->count, request->offset);
+            request->result = ret < 0 ? -errno : ret;
+            pthread_mutex_lock(&io->lock);
+            bool first = io->completed == nullptr;
+            request->next = io->completed;
+            io->completed = request;
+            if (first) {
+                uint64_t one = 1;
+                ssize_t unused = write(io->event_fd, &one, sizeof(one));
+                (void) unused;
+            }
+        }
+        pthread_mutex_unlock(&io->lock);
+        return nullptr;
+    }
+
+    bool open_pool() {
+        event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (event_fd < 0) {
+            return false;
+        }
+        // the pool threads take none of the process's signals, SIGVTALRM above all
+        sigset_t all, old;
+        sigfillset(&all);
+        pthread_sigmask(SIG_BLOCK, &all, &old);
+        for (int i = 0; i < FILE_IO_THREADS; i++) {
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, pool_main, this) != 0) {
+                break;
+            }
+            pool.push_back(thread);
+        }
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        if (pool.empty()) {
+            close(event_fd);
+            event_fd = -1;
+            return false;
+        }
+        // bind the calls submit and harvest make: the first call through a lazily bound symbol needs more stack
+        // than the timer handler has on a thread's stack
+        uint64_t value;
+        ssize_t unused = read(event_fd, &value, sizeof(value));
+        (void) unused;
+        pthread_mutex_lock(&lock);
+        pthread_cond_signal(&queued);
+        pthread_mutex_unlock(&lock);
+        return true;
+    }
+
+    bool submit_pool(FileRequest *request) {
+        request->next = nullptr;
+        pthread_mutex_lock(&lock);
+        *pending_tail = request;
+        pending_tail = &request->next;
+        pthread_cond_signal(&queued);
+        pthread_mutex_unlock(&lock);
+        return true;
+    }
+
+    template <class Complete>
+    int harvest_pool(Complete complete) {
+        uint64_t value;
+        ssize_t unused = read(event_fd, &value, sizeof(value));
+        (void) unused;
+        pthread_mutex_lock(&lock);
+        FileRequest *request = completed;
+        completed = nullptr;
+        pthread_mutex_unlock(&lock);
+        int count = 0;
+        while (request != nullptr) {
+            FileRequest *next = request->next;
+            complete(request);
+            request = next;
+            count++;
+        }
+        return count;
+    }
+
+public:
+    FileIo() : tried(false), opened(false), in_flight(0), ring_fd(-1), sq_map(nullptr), sq_map_size(0), cq_map(nullptr),
+               cq_map_size(0), sqes(nullptr), sqes_size(0), sq_head(nullptr), sq_tail(nullptr), sq_array(nullptr),
+               sq_flags(nullptr), sq_mask(0), sq_entries(0), cq_head(nullptr), cq_tail(nullptr), cqes(nullptr),
+               cq_mask(0), unsubmitted(0), event_fd(-1), pending(nullptr), pending_tail(&pending), completed(nullptr),
+               stopping(false) {
+        pthread_mutex_init(&lock, NULL);
+        pthread_cond_init(&queued, NULL);
+    }
+
+    ~FileIo() {
+        if (ring_fd >= 0) {
+            close_ring();
+        }
+        if (!pool.empty()) {
+            pthread_mutex_lock(&lock);
+            stopping = true;
+            pthread_cond_broadcast(&queued);
+            pthread_mutex_unlock(&lock);
+            // a pool thread may be stuck in a read of a pipe or a slow device: do not wait for it at exit
+            for (pthread_t thread : pool) {
+                pthread_detach(thread);
+            }
+            close(event_fd);
+        }
+    }
+
+    /**
+     * @brief Sets up the io_uring, or else the thread pool. Only the first call does, so it should be made on a
+     * large stack (pthread_create and the first calls through lazily bound symbols need one); later calls return
+     * its result.
+     *
+     * @return false if neither could be set up.
+     */
+    bool open() {
+        if (!tried) {
+            tried = true;
+#ifndef UTHREADS_FILE_IO_THREADS
+            opened = open_ring();
+#endif
+            opened = opened || open_pool();
+        }
+        return opened;
+    }
+
+    /**
+     * @brief True if requests are in flight, i.e. completions are worth harvesting.
+     */
+    bool active() const {
+        return in_flight > 0;
+    }
+
+    /**
+     * @brief A descriptor that is readable while completions are pending; -1 before open.
+     */
+    int fd() const {
+        return ring_fd >= 0 ? ring_fd : event_fd;
+    }
+
+    /**
+     * @brief Queues request, whose thread then parks until harvest completes it. open must have succeeded.
+     *
+     * @return false if it could not be queued (the submission ring is full and the kernel takes nothing).
+     */
+    bool submit(FileRequest *request) {
+        if (!(ring_fd >= 0 ? submit_ring(request) : submit_pool(request))) {
+            return false;
+        }
+        request->thread->add_entry();
+        in_flight++;
+        return true;
+    }
+
+    /**
+     * @brief Submits what is queued, then takes the completed requests without waiting and calls
+     * complete(request) for each, with its result set.
+     *
+     * @return The number of requests completed.
+     */
+    template <class Complete>
+    int harvest(Complete complete) {
+        int count = ring_fd >= 0 ? harvest_ring(complete) : harvest_pool(complete);
+        in_flight -= count;
+        return count;
+    }
+};
+
+#endif //_FILE_IO_H_
@@ -0,0 +1,243 @@
+#ifndef _IO_REACTOR_H_
+#define _IO_REACTOR_H_
+
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <vector>
+#include "Thread.h"
+#include "ReadyQueue.h"
+
+#define IO_EVENTS 64 /* events taken from epoll at a time */
+
+/**
+ * @brief The threads parked until a file descriptor is readable or writable (uthread_read and friends), and the
+ * epoll instance that watches those descriptors.
+ *
+ * A descriptor is registered one-shot (EPOLLONESHOT) for the directions its parked threads wait for, and armed
+ * again every time a thread parks on it: arming reports a descriptor that is ready already, so readiness that
+ * came between the thread's failed attempt and its parking is not lost. When an event comes in, every thread
+ * parked for that direction is woken and tries again; the losers of a race park again.
+ *
+ * Parked threads sit in a ReadyQueue per direction, WAITING like the waiters of a mutex, so blocking them needs
+ * nothing from the reactor. A terminated one is taken out through erase, which disarms its descriptor once nobody
+ * waits on it: no event may ever come for it (the user may also have closed it, which drops it from the epoll set
+ * silently), and an armed descriptor keeps the reactor active for good. An eventfd in the epoll set lets the scheduler interrupt a worker
+ * that sleeps in the reactor (see notify).
+ *
+ * Everything but notify is called inside the library. Nothing allocates after a descriptor's first park.
+ */
+class IoReactor {
+public:
+    struct Watch {
+        ReadyQueue readers;
+        ReadyQueue writers;
+        bool registered; // in the epoll set (it may have been closed since: arming then registers it again)
+        bool armed;      // an event is pending for it
+
+        Watch() : registered(false), armed(false) {}
+    };
+
+private:
+    int epoll_fd;
+    int wake_fd;
+    std::vector<Watch *> watches; // by descriptor
+    int armed;
+    struct epoll_event events[IO_EVENTS]; // not on the stack: harvest may run in the timer handler
+
+    /**
+     * @brief (Re)arms fd for the directions its threads wait for.
+     *
+     * @return false if epoll refused it (errno set).
+     */
+    bool arm(int fd, Watch *watch) {
+        struct epoll_event event = {};
+        event.events = EPOLLONESHOT | EPOLLRDHUP;
+        if (!watch->readers.empty()) {
+            event.events |= EPOLLIN;
+        }
+        if (!watch->writers.empty()) {
+            event.events |= EPOLLOUT;
+        }
+        event.data.fd = fd;
+        int ret = -1;
+        if (watch->registered) {
+            ret = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+        }
+        if (ret < 0) {
+            // first park, or closed (and maybe reused) since it was registered
+            ret = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+            if (ret < 0 && errno == EEXIST) {
+                ret = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+            }
+        }
+        if (ret < 0) {
+            return false;
+        }
+        watch->registered = true;
+        if (!watch->armed) {
+            watch->armed = true;
+            armed++;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Takes fd, which nobody waits on any more, out of the epoll set, if it is armed.
+     */
+    void disarm(int fd, Watch *watch) {
+        if (!watch->armed) {
+            return;
+        }
+        // fails if fd was closed meanwhile, which took it out already
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+        watch->registered = false;
+        watch->armed = false;
+        armed--;
+    }
+
+public:
+    IoReactor() : epoll_fd(-1), wake_fd(-1), armed(0) {}
+
+    ~IoReactor() {
+        for (size_t fd = 0; fd < watches.size(); fd++) {
+            delete watches[fd];
+        }
+        if (epoll_fd >= 0) {
+            close(epoll_fd);
+            close(wake_fd);
+        }
+    }
+
+    /**
+     * @brief Creates the epoll instance and its eventfd on first use.
+     *
+     * @return false if that failed (errno set).
+     */
+    bool open() {
+        if (epoll_fd >= 0) {
+            return true;
+        }
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0) {
+            return false;
+        }
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = wake_fd;
+        if (wake_fd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) < 0) {
+            close(epoll_fd);
+            epoll_fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief True if some descriptor is armed, i.e. the reactor is worth polling.
+     */
+    bool active() const {
+        return armed > 0;
+    }
+
+    /**
+     * @brief The epoll descriptor, readable when events are pending; -1 before open.
+     */
+    int fd() const {
+        return epoll_fd;
+    }
+
+    /**
+     * @brief Parks thread on fd until fd is readable (or writable, if write). open must have succeeded.
+     *
+     * @return false if fd cannot be watched (errno set; e.g. a regular file, which is always ready): the thread
+     * is not parked.
+     */
+    bool park(Thread *thread, int fd, bool write) {
+        if ((size_t) fd >= watches.size()) {
+            watches.resize(fd + 1, nullptr);
+        }
+        if (watches[fd] == nullptr) {
+            watches[fd] = new Watch();
+        }
+        Watch *watch = watches[fd];
+        ReadyQueue &queue = write ? watch->writers : watch->readers;
+        queue.push_back(thread);
+        thread->io_fd = fd;
+        if (!arm(fd, watch)) {
+            queue.erase(thread);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Takes thread out of the reactor (it is being terminated), disarming its descriptor if no other thread
+     * waits on it.
+     *
+     * @return true if the thread was parked here, false otherwise.
+     */
+    bool erase(Thread *thread) {
+        int fd = thread->io_fd;
+        if (fd < 0) {
+            return false;
+        }
+        thread->io_fd = -1;
+        Watch *watch = watches[fd];
+        if (!watch->readers.erase(thread) && !watch->writers.erase(thread)) {
+            return false;
+        }
+        if (watch->readers.empty() && watch->writers.empty()) {
+            disarm(fd, watch);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Takes the pending events without waiting, and calls wake(queue) for every queue of threads whose
+     * descriptor became ready. Descriptors that still have parked threads are armed again.
+     *
+     * @return The number of events taken.
+     */
+    template <class Wake>
+    int harvest(Wake wake) {
+        int count = epoll_wait(epoll_fd, events, IO_EVENTS, 0);
+        for (int i = 0; i < count; i++) {
+            int fd = events[i].data.fd;
+            if (fd == wake_fd) {
+                uint64_t value;
+                ssize_t unused = read(wake_fd, &value, sizeof(value));
+                (void) unused;
+                continue;
+            }
+            Watch *watch = watches[fd];
+            watch->armed = false;
+            armed--;
+            uint32_t ready = events[i].events;
+            if (ready & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                wake(watch->readers);
+            }
+            if (ready & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+                wake(watch->writers);
+            }
+            if (!watch->readers.empty() || !watch->writers.empty()) {
+                arm(fd, watch);
+            }
+        }
+        return count < 0 ? 0 : count;
+    }
+
+    /**
+     * @brief Makes a worker that sleeps on fd() return. Safe without the scheduler lock.
+     */
+    void notify() {
+        uint64_t one = 1;
+        ssize_t unused = write(wake_fd, &one, sizeof(one));
+        (void) unused;
+    }
+};
+
+#endif //_IO_REACTOR_H_
@@ -0,0 +1,117 @@
+#ifndef _MLFQ_POLICY_H_
+#define _MLFQ_POLICY_H_
+
+#include <stdint.h>
+#include "Thread.h"
+#include "ReadyQueue.h"
+
+#define MLFQ_BOOST_QUANTUMS 50 /* every level is reset to the thread's priority this often */
+
+/**
+ * @brief Multilevel feedback queue: one FIFO per level, the lowest non-empty level runs first.
+ *
+ * A thread starts at the level of its priority (uthread_set_priority) and moves with its behaviour: one level
+ * down each time it is preempted at the end of a quantum it used up, one level back up (never above its priority)
+ * each time it gives up the CPU before that (blocks, sleeps, waits or yields). So CPU-bound threads sink and
+ * threads that mostly wait stay on top. To keep the sunk threads from starving, every MLFQ_BOOST_QUANTUMS
+ * quantums all threads go back to their priority's level: the queued ones at once, the others (running, blocked,
+ * sleeping...) when they are next queued, which they notice from Thread::boost_epoch.
+ *
+ * A bitmap of the non-empty levels makes picking O(1).
+ */
+class MlfqPolicy {
+private:
+    static_assert(UTHREAD_PRIORITIES <= 32, "the levels must fit in the occupied bitmap");
+
+    ReadyQueue levels[UTHREAD_PRIORITIES];
+    unsigned occupied;
+    unsigned epoch;
+
+    /**
+     * @brief Applies a boost the thread missed while it was not queued.
+     */
+    void catch_up(Thread *thread) {
+        if (thread->boost_epoch != epoch) {
+            thread->boost_epoch = epoch;
+            thread->level = thread->priority;
+        }
+    }
+
+    void push(Thread *thread) {
+        levels[thread->level].push_back(thread);
+        occupied |= 1u << thread->level;
+    }
+
+    void boost() {
+        epoch++;
+        for (int level = 1; level < UTHREAD_PRIORITIES; level++) {
+            ReadyQueue &queue = levels[level];
+            for (int n = queue.size(); n > 0; n--) {
+                Thread *thread = queue.pop_front();
+                catch_up(thread);
+                push(thread);
+            }
+            if (queue.empty()) {
+                occupied &= ~(1u << level);
+            }
+        }
+    }
+
+public:
+    static const bool work_stealing = false;
+
+    MlfqPolicy() : occupied(0), epoch(0) {}
+
+    void reserve(int) {}
+
+    void enqueue(Thread *thread) {
+        catch_up(thread);
+        push(thread);
+    }
+
+    Thread *dequeue() {
+        if (occupied == 0) {
+            return nullptr;
+        }
+        int level = __builtin_ctz(occupied);
+        Thread *thread = levels[level].pop_front();
+        if (levels[level].empty()) {
+            occupied &= ~(1u << level);
+        }
+        return thread;
+    }
+
+    bool erase(Thread *thread) {
+        ReadyQueue &queue = levels[thread->level];
+        if (!queue.erase(thread)) {
+            return false;
+        }
+        if (queue.empty()) {
+            occupied &= ~(1u << thread->level);
+        }
+        return true;
+    }
+
+    void stopped(Thread *thread, bool expired) {
+        catch_up(thread);
+        if (expired) {
+            if (thread->level < UTHREAD_PRIORITIES - 1) {
+                thread->level++;
+            }
+        } else if (thread->level > thread->priority) {
+            thread->level--;
+        }
+    }
+
+    void new_quantum(int quantum) {
+        if (quantum % MLFQ_BOOST_QUANTUMS == 0) {
+            boost();
+        }
+    }
+
+    uint64_t slice(const Thread *) const {
+        return 0;
+    }
+};
+
+#endif //_MLFQ_POLICY_H_
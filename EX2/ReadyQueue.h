@@ -0,0 +1,95 @@
+#ifndef _READY_QUEUE_H_
+#define _READY_QUEUE_H_
+
+#include "Thread.h"
+
+/**
+ * @brief FIFO of READY threads, linked through the next/prev pointers embedded in Thread. Also the wait queue of
+ * a mutex, a condition variable or an address, whose threads are WAITING.
+ *
+ * Nothing is allocated: push_back, pop_front and erase of an arbitrary thread are all O(1).
+ * A thread is in at most one queue at a time; Thread::queue tells which one (nullptr if none).
+ */
+class ReadyQueue {
+private:
+    Thread *head;
+    Thread *tail;
+    int count;
+
+public:
+    ReadyQueue() : head(nullptr), tail(nullptr), count(0) {}
+
+    bool empty() const {
+        return head == nullptr;
+    }
+
+    int size() const {
+        return count;
+    }
+
+    Thread *front() const {
+        return head;
+    }
+
+    bool contains(const Thread *thread) const {
+        return thread->queue == this;
+    }
+
+    void push_back(Thread *thread) {
+        thread->queue = this;
+        thread->next = nullptr;
+        thread->prev = tail;
+        if (tail != nullptr) {
+            tail->next = thread;
+        } else {
+            head = thread;
+        }
+        tail = thread;
+        count++;
+    }
+
+    Thread *pop_front() {
+        Thread *thread = head;
+        if (thread != nullptr) {
+            erase(thread);
+        }
+        return thread;
+    }
+
+    /**
+     * @brief Unlinks thread from the queue.
+     *
+     * @return true if the thread was queued here, false otherwise.
+     */
+    bool erase(Thread *thread) {
+        if (!contains(thread)) {
+            return false;
+        }
+        if (thread->prev != nullptr) {
+            thread->prev->next = thread->next;
+        } else {
+            head = thread->next;
+        }
+        if (thread->next != nullptr) {
+            thread->next->prev = thread->prev;
+        } else {
+            tail = thread->prev;
+        }
+        thread->next = nullptr;
+        thread->prev = nullptr;
+        thread->queue = nullptr;
+        count--;
+        return true;
+    }
+
+    /**
+     * @brief Unlinks thread from whichever queue holds it.
+     *
+     * @return true if the thread was queued, false otherwise.
+     */
+    static bool remove(Thread *thread) {
+        return thread->queue != nullptr && thread->queue->erase(thread);
+    }
+};
+
+#endif //_READY_QUEUE_H_
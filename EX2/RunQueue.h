@@ -0,0 +1,100 @@
+#ifndef _RUN_QUEUE_H_
+#define _RUN_QUEUE_H_
+
+#include <atomic>
+#include "Thread.h"
+#include "FifoPolicy.h"
+#include "MlfqPolicy.h"
+#include "CfsPolicy.h"
+#include "EdfPolicy.h"
+
+/**
+ * @brief The READY threads, in the order a scheduling policy picks them.
+ *
+ * The policy is a template argument, fixed at compile time (-DUTHREADS_POLICY=<class>, FifoPolicy by default), so
+ * its calls are inlined into the scheduler. A policy class provides:
+ * - void reserve(int)       makes room for that many threads, so that nothing allocates once threads run;
+ * - void enqueue(Thread *)   a thread became READY;
+ * - Thread *dequeue()        takes the thread to run next, nullptr if there is none;
+ * - bool erase(Thread *)     takes a READY thread out (blocked or terminated), false if it was not queued;
+ * - void stopped(Thread *, bool expired)   the running thread stops running: preempted at the end of its
+ *                            quantum (expired), or giving up the CPU itself;
+ * - void new_quantum(int)    a quantum starts, with its number (uthread_get_total_quantums);
+ * - uint64_t slice(const Thread *)   nanoseconds the thread may run before it is preempted, if that is less than
+ *                            a quantum; 0 for a full quantum;
+ * - static const bool work_stealing   true if, with several workers, the work-stealing deques may stand in for
+ *                            it. They can only keep FIFO order; any other policy keeps one RunQueue shared by all
+ *                            the workers instead, so its order holds across them. Such a policy's stopped,
+ *                            new_quantum and slice are called under a worker's share of the scheduler lock, by
+ *                            several workers at once (see SchedLock): they must not keep any state.
+ *
+ * On top of the policy, the RunQueue counts its threads in an atomic, so idle workers can check for work without
+ * the scheduler lock.
+ */
+template <class Policy>
+class RunQueue {
+private:
+    Policy policy;
+    std::atomic<int> count;
+
+public:
+    static const bool work_stealing = Policy::work_stealing;
+
+    RunQueue() : count(0) {}
+
+    void reserve(int capacity) {
+        policy.reserve(capacity);
+    }
+
+    void push(Thread *thread) {
+        policy.enqueue(thread);
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    Thread *pop() {
+        Thread *thread = policy.dequeue();
+        if (thread != nullptr) {
+            count.store(count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        }
+        return thread;
+    }
+
+    bool erase(Thread *thread) {
+        if (!policy.erase(thread)) {
+            return false;
+        }
+        count.store(count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    void stopped(Thread *thread, bool expired) {
+        policy.stopped(thread, expired);
+    }
+
+    void new_quantum(int quantum) {
+        policy.new_quantum(quantum);
+    }
+
+    uint64_t slice(const Thread *thread) const {
+        return policy.slice(thread);
+    }
+
+    /**
+     * @brief Safe without the scheduler lock, as a hint.
+     */
+    bool empty() const {
+        return count.load(std::memory_order_relaxed) == 0;
+    }
+
+    int size() const {
+        return count.load(std::memory_order_relaxed);
+    }
+};
+
+#ifndef UTHREADS_POLICY
+#define UTHREADS_POLICY FifoPolicy
+#endif
+
+typedef RunQueue<UTHREADS_POLICY> SchedQueue;
+
+#endif //_RUN_QUEUE_H_
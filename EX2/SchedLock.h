@@ -0,0 +1,100 @@
+#ifndef _SCHED_LOCK_H_
+#define _SCHED_LOCK_H_
+
+#include <atomic>
+#include "SpinLock.h"
+
+#define CACHE_LINE_SIZE 64
+
+/**
+ * @brief The scheduler lock of several workers: a share per worker, and the whole lock.
+ *
+ * A worker that only switches between threads on the work-stealing deques holds its own share (try_lock_shared).
+ * A share is a flag on a cache line of its own that no other worker writes, so workers doing that run side by
+ * side, and no lock word bounces between their caches. Everything else takes the whole lock, which excludes the
+ * other holders of the whole lock and waits until no share is held.
+ *
+ * A taker of the whole lock announces itself first, and a share is only tried: a worker that finds the whole lock
+ * taken or wanted takes the whole lock itself instead of waiting for a share. Neither side starves the other.
+ */
+class SchedLock {
+private:
+    struct Share {
+        std::atomic<bool> held;
+        char padding[CACHE_LINE_SIZE - sizeof(std::atomic<bool>)];
+    };
+
+    std::atomic<bool> whole;
+    Share *shares;
+    int count;
+
+public:
+    SchedLock() : whole(false), shares(nullptr), count(0) {}
+
+    /**
+     * @brief Makes a share for each of workers workers. Before any of them runs.
+     */
+    void init(int workers) {
+        shares = new Share[workers];
+        count = workers;
+        for (int i = 0; i < workers; i++) {
+            shares[i].held.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief Takes worker's share, unless the whole lock is taken or wanted.
+     *
+     * The share is published before the whole lock is looked at, and a taker of the whole lock announces itself
+     * before it looks at the shares (both seq_cst): at least one of the two sees the other.
+     */
+    bool try_lock_shared(int worker) {
+        std::atomic<bool> &held = shares[worker].held;
+        held.exchange(true, std::memory_order_seq_cst);
+        if (!whole.load(std::memory_order_seq_cst)) {
+            return true;
+        }
+        held.store(false, std::memory_order_release);
+        return false;
+    }
+
+    void unlock_shared(int worker) {
+        shares[worker].held.store(false, std::memory_order_release);
+    }
+
+    void lock() {
+        int spins = 0;
+        while (whole.exchange(true, std::memory_order_seq_cst)) {
+            while (whole.load(std::memory_order_relaxed)) {
+                SpinLock::relax(spins);
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            while (shares[i].held.load(std::memory_order_seq_cst)) {
+                SpinLock::relax(spins);
+            }
+        }
+    }
+
+    /**
+     * @brief Takes the whole lock if nobody holds it, nor any share.
+     */
+    bool try_lock() {
+        if (whole.load(std::memory_order_relaxed) || whole.exchange(true, std::memory_order_seq_cst)) {
+            return false;
+        }
+        for (int i = 0; i < count; i++) {
+            if (shares[i].held.load(std::memory_order_seq_cst)) {
+                whole.store(false, std::memory_order_release);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void unlock() {
+        whole.store(false, std::memory_order_release);
+    }
+};
+
+#endif //_SCHED_LOCK_H_
@@ -0,0 +1,94 @@
+#ifndef _SLEEP_QUEUE_H_
+#define _SLEEP_QUEUE_H_
+
+#include <stdint.h>
+#include "Thread.h"
+#include "ThreadHeap.h"
+
+/**
+ * @brief Min-heap of sleeping threads keyed on the absolute time at which they wake up.
+ *
+ * The time is whatever unit the owner uses, the same for all its sleepers: a quantum number (uthread_sleep) or
+ * CLOCK_MONOTONIC nanoseconds (uthread_wait_period). A thread sleeps in one queue at a time.
+ *
+ * Every thread remembers its slot in the heap (Thread::sleep_index, see ThreadHeap), so a sleeper can also be
+ * removed from the middle when it is terminated. A tick only looks at the top of the heap, so its cost depends on
+ * the number of threads that actually expire, not on how many are asleep.
+ */
+class SleepQueue {
+private:
+    static bool earlier(const Thread *a, const Thread *b) {
+        return a->wake_at < b->wake_at;
+    }
+
+    ThreadHeap<&SleepQueue::earlier, &Thread::sleep_index> heap;
+
+public:
+    /**
+     * @brief Reserves room for capacity sleepers, so push never allocates afterwards.
+     */
+    explicit SleepQueue(int capacity) {
+        heap.reserve(capacity);
+    }
+
+    void reserve(int capacity) {
+        heap.reserve(capacity);
+    }
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    int size() const {
+        return heap.size();
+    }
+
+    /**
+     * @brief True if thread sleeps in this queue (and not in another one).
+     */
+    bool contains(const Thread *thread) const {
+        return heap.contains(thread);
+    }
+
+    /**
+     * @return The thread that wakes up first. The queue must not be empty.
+     */
+    Thread *top() const {
+        return heap.top();
+    }
+
+    /**
+     * @return The time the first sleeper wakes up at. The queue must not be empty.
+     */
+    uint64_t next_wake() const {
+        return heap.top()->wake_at;
+    }
+
+    void push(Thread *thread, uint64_t wake_at) {
+        thread->wake_at = wake_at;
+        heap.push(thread);
+    }
+
+    /**
+     * @brief Removes thread from the queue.
+     *
+     * @return true if the thread was sleeping, false otherwise.
+     */
+    bool erase(Thread *thread) {
+        return heap.erase(thread);
+    }
+
+    /**
+     * @brief Pops the first sleeper if it is due by time now.
+     *
+     * @return The expired thread, or nullptr if nobody is due.
+     */
+    Thread *pop_expired(uint64_t now) {
+        if (heap.empty() || heap.top()->wake_at > now) {
+            return nullptr;
+        }
+        return heap.pop();
+    }
+};
+
+#endif //_SLEEP_QUEUE_H_
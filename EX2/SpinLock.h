@@ -0,0 +1,56 @@
+#ifndef _SPIN_LOCK_H_
+#define _SPIN_LOCK_H_
+
+#include <atomic>
+#include <sched.h>
+
+#define SPIN_LOCK_SPINS 128
+
+/**
+ * @brief Test-and-test-and-set lock for short critical sections inside the library; its spin-wait step is also
+ * SchedLock's.
+ *
+ * Holders never sleep and are never preempted by the library (the lock is only taken inside it), so a waiter
+ * spins at most for the length of one library call on another worker - unless the kernel descheduled that
+ * worker, which is why a waiter that spun SPIN_LOCK_SPINS times gives up its core with sched_yield.
+ */
+class SpinLock {
+private:
+    std::atomic<bool> locked;
+
+public:
+    /**
+     * @brief One step of a spin-wait loop; spins counts the steps taken so far.
+     */
+    static void relax(int &spins) {
+        if (++spins < SPIN_LOCK_SPINS) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        } else {
+            spins = 0;
+            sched_yield();
+        }
+    }
+
+    SpinLock() : locked(false) {}
+
+    void lock() {
+        int spins = 0;
+        while (locked.exchange(true, std::memory_order_acquire)) {
+            while (locked.load(std::memory_order_relaxed)) {
+                relax(spins);
+            }
+        }
+    }
+
+    bool try_lock() {
+        return !locked.load(std::memory_order_relaxed) && !locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() {
+        locked.store(false, std::memory_order_release);
+    }
+};
+
+#endif //_SPIN_LOCK_H_
@@ -0,0 +1,187 @@
+#ifndef _STACK_POOL_H_
+#define _STACK_POOL_H_
+
+#include <stddef.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <vector>
+
+#define STACKS_PER_REGION 64
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+#define MAX_MAP_COUNT_FILE "/proc/sys/vm/max_map_count"
+#define DEFAULT_MAX_MAP_COUNT 65530
+
+/**
+ * @brief Thread stacks carved from large mmap'd regions and recycled LIFO.
+ *
+ * A region holds STACKS_PER_REGION slots of [guard page(s) | stack]. The guard sits below the stack (stacks
+ * grow down) and is mapped PROT_NONE, so an overflow faults instead of corrupting the neighbour. Released
+ * stacks go on a LIFO free list: the next spawn gets the most recently used, still cache- and TLB-warm, stack.
+ * Regions are never unmapped (not even at exit, which may run on a thread stack), so a terminated thread can
+ * keep running on its released stack until it switches away.
+ *
+ * Stacks larger than the pool's size are mapped one by one, also with MAP_NORESERVE and a guard page, and
+ * unmapped on release: their pages are only committed when the thread actually touches them.
+ *
+ * Every guard splits its region into two more mappings, and the kernel caps a process at vm.max_map_count
+ * mappings. Only the first quarter of that budget is spent on guards; stacks beyond it have none, so that tens
+ * of thousands of threads (and everybody else's mmap) keep working.
+ *
+ * In huge-page mode guards are left out (they would split the huge pages); regions are mapped with MAP_HUGETLB,
+ * or advised with MADV_HUGEPAGE if no huge pages are reserved.
+ */
+class StackPool {
+private:
+    size_t page_size;
+    size_t stack_size;
+    size_t guard_size;
+    size_t slot_size;
+    bool huge_pages;
+    long guards_left;
+    std::vector<char *> free_stacks;
+
+    static size_t round_up(size_t size, size_t unit) {
+        return (size + unit - 1) / unit * unit;
+    }
+
+    static long max_map_count() {
+        long count = DEFAULT_MAX_MAP_COUNT;
+        FILE *file = fopen(MAX_MAP_COUNT_FILE, "r");
+        if (file != NULL) {
+            if (fscanf(file, "%ld", &count) != 1) {
+                count = DEFAULT_MAX_MAP_COUNT;
+            }
+            fclose(file);
+        }
+        return count;
+    }
+
+    /**
+     * @brief Turns the page at guard into a guard page, while the mapping budget lasts.
+     */
+    void protect(char *guard) {
+        if (guards_left > 0 && mprotect(guard, page_size, PROT_NONE) == 0) {
+            guards_left--;
+        }
+    }
+
+    /**
+     * @brief Maps a new region and pushes its stacks on the free list.
+     *
+     * @return false if the region could not be mapped.
+     */
+    bool grow() {
+        size_t region_size = slot_size * STACKS_PER_REGION;
+        char *region = (char *) MAP_FAILED;
+        if (huge_pages) {
+            region_size = round_up(region_size, HUGE_PAGE_SIZE);
+            // no MAP_NORESERVE here: without a reservation a missing huge page is a SIGBUS on first touch
+            region = (char *) mmap(NULL, region_size, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+        if (region == MAP_FAILED) {
+            region = (char *) mmap(NULL, region_size, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (region == MAP_FAILED) {
+                return false;
+            }
+            if (huge_pages) {
+                madvise(region, region_size, MADV_HUGEPAGE);
+            }
+        }
+        // push in reverse so the lowest slot is handed out first
+        for (int slot = (int) (region_size / slot_size) - 1; slot >= 0; slot--) {
+            char *guard = region + slot * slot_size;
+            if (guard_size > 0) {
+                protect(guard);
+            }
+            free_stacks.push_back(guard + guard_size);
+        }
+        return true;
+    }
+
+public:
+    /**
+     * @param stack_size Usable bytes per stack, rounded up to whole pages.
+     * @param huge_pages Back the stacks with huge pages (and give up guard pages).
+     */
+    explicit StackPool(size_t stack_size, bool huge_pages = false) : huge_pages(huge_pages) {
+        page_size = (size_t) sysconf(_SC_PAGESIZE);
+        this->stack_size = round_up(stack_size, page_size);
+        guard_size = huge_pages ? 0 : page_size;
+        slot_size = this->stack_size + guard_size;
+        guards_left = max_map_count() / 4;
+    }
+
+    /**
+     * @return The lowest address of a stack of get_stack_size() bytes, or nullptr if no memory is left.
+     */
+    char *acquire() {
+        if (free_stacks.empty() && !grow()) {
+            return nullptr;
+        }
+        char *stack = free_stacks.back();
+        free_stacks.pop_back();
+        return stack;
+    }
+
+    /**
+     * @brief Gets a stack of at least size bytes: from the pool if it fits, otherwise a dedicated mapping.
+     *
+     * @param size Requested size; updated to the usable size actually provided.
+     * @return The lowest address of the stack, or nullptr if no memory is left.
+     */
+    char *acquire(size_t &size) {
+        if (size <= stack_size) {
+            size = stack_size;
+            return acquire();
+        }
+        size = round_up(size, page_size);
+        char *guard = (char *) mmap(NULL, size + page_size, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (guard == MAP_FAILED) {
+            return nullptr;
+        }
+        protect(guard);
+        return guard + page_size;
+    }
+
+    void release(char *stack) {
+        free_stacks.push_back(stack);
+    }
+
+    /**
+     * @brief Returns a stack obtained from acquire(size); size is the usable size acquire reported.
+     */
+    void release(char *stack, size_t size) {
+        if (size <= stack_size) {
+            release(stack);
+        } else {
+            munmap(stack - page_size, size + page_size);
+        }
+    }
+
+    /**
+     * @return How many bytes of the stack are backed by physical memory (resident pages). A recycled stack keeps
+     * the pages its earlier owners touched, so this is at least as much as they committed.
+     */
+    size_t committed(char *stack, size_t size) const {
+        size_t pages = size / page_size;
+        std::vector<unsigned char> resident(pages);
+        if (mincore(stack, size, resident.data()) < 0) {
+            return 0;
+        }
+        size_t count = 0;
+        for (size_t i = 0; i < pages; i++) {
+            count += resident[i] & 1;
+        }
+        return count * page_size;
+    }
+
+    size_t get_stack_size() const {
+        return stack_size;
+    }
+};
+
+#endif //_STACK_POOL_H_
@@ -2,11 +2,13 @@
 #define _THREAD_H_
 
 #include <setjmp.h>
-#include <deque>
 #include <unistd.h>
 #include <signal.h>
 #include <sys/time.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include "Context.h"
 #include "uthreads.h"
 
 #ifdef __x86_64__
@@ -18,7 +20,7 @@ typedef unsigned long address_t;
 
 /* A translation is required when using an address of a variable.
    Use this as a black box in your code. */
-address_t translate_address(address_t addr)
+inline address_t translate_address(address_t addr)
 {
     address_t ret;
     asm volatile("xor    %%fs:0x30,%0\n"
@@ -38,7 +40,7 @@ typedef unsigned int address_t;
 
 /* A translation is required when using an address of a variable.
    Use this as a black box in your code. */
-address_t translate_address(address_t addr)
+inline address_t translate_address(address_t addr)
 {
     address_t ret;
     asm volatile("xor    %%gs:0x18,%0\n"
@@ -51,39 +53,147 @@ address_t translate_address(address_t addr)
 
 typedef void (*thread_entry_point)(void);
 
+class ReadyQueue;
+class SleepQueue;
+class WaitTable;
+class MlfqPolicy;
+class CfsPolicy;
+class EdfPolicy;
+
 typedef enum State {
     READY,
     RUNNING,
     BLOCKED,
     SLEEPING,
     SLEEPING_AND_BLOCKED,
+    WAITING, // parked in a wait queue: of a mutex, a condition variable, an address (uthread_wait) or a channel
+    WAITING_AND_BLOCKED,
+    TERMINATED, // terminated while running or queued elsewhere; freed by the worker that switches away from it or
+                // takes its last entry off a run queue
 } State;
 
 class Thread {
 private:
     const int tid;
     int quantums;
-    State state;
+    // atomic: a worker holding only its share of the scheduler lock claims a READY thread off a deque (see claim)
+    std::atomic<State> state;
     char *t_stack;
+    size_t stack_size;
+    thread_entry_point entry;
+#ifdef UTHREADS_ASM_SWITCH
+    Context context;
+#else
     sigjmp_buf env;
+#endif
 
-public:
-    static int id[MAX_THREAD_NUM];
+    // intrusive ready-queue links, owned by ReadyQueue
+    friend class ReadyQueue;
+    Thread *next;
+    Thread *prev;
+    ReadyQueue *queue;
+
+    // sleep-queue key and heap slot, owned by SleepQueue
+    friend class SleepQueue;
+    uint64_t wake_at;
+    int sleep_index;
+
+    // address waited on with uthread_wait, nullptr if none; owned by WaitTable
+    friend class WaitTable;
+    const void *wait_addr;
+
+    // descriptor the thread last parked on in the I/O reactor, -1 if none; owned by IoReactor
+    friend class IoReactor;
+    int io_fd;
+
+    // element a thread parked on a channel sends (or receives into)
+    void *transfer;
+
+    // priority given with uthread_set_priority (0 is the highest)
+    int priority;
+
+    // current MLFQ level, and the MLFQ boost the level dates from; owned by MlfqPolicy
+    friend class MlfqPolicy;
+    int level;
+    unsigned boost_epoch;
 
-    Thread() : tid(0), quantums(0), state(RUNNING), t_stack(nullptr) {
+    // nanoseconds the thread ran for, up to its last switch (or its worker's last scheduler call)
+    uint64_t runtime;
+
+    // weight given with uthread_set_weight
+    int weight;
+
+    // virtual runtime, the part of runtime already added to it, and slot in the CFS heap; owned by CfsPolicy
+    friend class CfsPolicy;
+    uint64_t vruntime;
+    uint64_t vruntime_charged;
+    int cfs_index;
+
+    // real-time parameters given with uthread_set_deadline in nanoseconds (period 0 if the thread has none), the
+    // absolute CLOCK_MONOTONIC deadline of its current job, its runtime when that job was released, and the number
+    // of its jobs that ended late
+    uint64_t period;
+    uint64_t budget;
+    uint64_t deadline;
+    uint64_t job_start;
+    long deadline_misses;
+
+    // slot in the EDF deadline heap, -1 if the thread is not in it; owned by EdfPolicy
+    friend class EdfPolicy;
+    int edf_index;
+
+    // index of the worker running the thread, -1 if it is not running
+    int worker;
+
+    // switched out by the timer handler, and resumes inside it
+    bool preempted;
+
+    // entries on work-stealing deques (multi-worker mode), stolen from one and not settled yet, or in a worker's
+    // run_next; more than one if uthread_switch_to ran the thread ahead of an entry, which is then stale. A file
+    // request in flight (FileIo) also holds one, so the thread and its stack outlive a termination until it completes,
+    // and so does the CPU of a thread terminated while it runs. Workers take entries at the same time, under their
+    // shares of the scheduler lock; whoever drops the last one of a terminated thread frees it
+    std::atomic<int> entries;
+
+public:
+    /**
+     * @brief Wraps the kernel thread calling it (the main thread, or a worker's own stack), already running.
+     */
+    explicit Thread(const int tid = 0) : tid(tid), quantums(0), state(RUNNING), t_stack(nullptr), stack_size(0),
+               entry(nullptr), next(nullptr), prev(nullptr), queue(nullptr), wake_at(0), sleep_index(-1),
+               wait_addr(nullptr), io_fd(-1), transfer(nullptr), priority(0), level(0), boost_epoch(0), runtime(0),
+               weight(UTHREAD_DEFAULT_WEIGHT), vruntime(0), vruntime_charged(0), cfs_index(-1), period(0),
+               budget(0), deadline(0), job_start(0), deadline_misses(0), edf_index(-1), worker(0), preempted(false),
+               entries(0) {
+#ifdef UTHREADS_ASM_SWITCH
+        context.sp = nullptr;
+#else
         sigsetjmp(env, 1);
         sigemptyset(&env->__saved_mask);
+#endif
     }
 
-    Thread(const int tid, thread_entry_point entry) :
-            tid(tid), quantums(0), state(READY) {
-        this->t_stack = new char[STACK_SIZE];
-        address_t sp = (address_t) t_stack + STACK_SIZE - sizeof(address_t);
-        address_t pc = (address_t) entry;
+    /**
+     * @brief Creates a thread that starts by running start() on the given stack; start is expected to call
+     * the thread's entry point (see get_entry). The stack is owned by the caller.
+     */
+    Thread(const int tid, thread_entry_point entry, thread_entry_point start, char *stack, size_t stack_size) :
+            tid(tid), quantums(0), state(READY), t_stack(stack), stack_size(stack_size), entry(entry),
+            next(nullptr), prev(nullptr), queue(nullptr), wake_at(0), sleep_index(-1),
+            wait_addr(nullptr), io_fd(-1), transfer(nullptr), priority(0), level(0), boost_epoch(0), runtime(0),
+            weight(UTHREAD_DEFAULT_WEIGHT), vruntime(0), vruntime_charged(0), cfs_index(-1), period(0),
+            budget(0), deadline(0), job_start(0), deadline_misses(0), edf_index(-1), worker(-1), preempted(false),
+            entries(0) {
+#ifdef UTHREADS_ASM_SWITCH
+        context_init(&context, t_stack, stack_size, start);
+#else
+        address_t sp = (address_t) t_stack + stack_size - sizeof(address_t);
+        address_t pc = (address_t) start;
         sigsetjmp(env, 1);
         (env->__jmpbuf)[JB_SP] = translate_address(sp);
         (env->__jmpbuf)[JB_PC] = translate_address(pc);
         sigemptyset(&env->__saved_mask);
+#endif
     }
 
     void set_quantums(int quantums) {
@@ -103,24 +213,159 @@ public:
     }
 
     void set_state(State state) {
-        this->state = state;
+        this->state.store(state, std::memory_order_release);
+    }
+
+    State get_state() const {
+        return state.load(std::memory_order_acquire);
     }
 
-    State get_state() {
-        return state;
+    /**
+     * @brief Makes a READY thread RUNNING, unless another worker did first through another of its entries.
+     *
+     * @return true if this call took it from READY.
+     */
+    bool claim() {
+        State ready = READY;
+        return state.compare_exchange_strong(ready, RUNNING, std::memory_order_acq_rel);
     }
 
     int get_tid() const {
         return tid;
     }
 
-    sigjmp_buf* get_env() {
-        return &env;
+    char *get_stack() const {
+        return t_stack;
+    }
+
+    size_t get_stack_size() const {
+        return stack_size;
+    }
+
+    thread_entry_point get_entry() const {
+        return entry;
+    }
+
+    int get_worker() const {
+        return worker;
+    }
+
+    void set_worker(int worker) {
+        this->worker = worker;
+    }
+
+    bool is_preempted() const {
+        return preempted;
+    }
+
+    void set_preempted(bool preempted) {
+        this->preempted = preempted;
+    }
+
+    void *get_transfer() const {
+        return transfer;
+    }
+
+    void set_transfer(void *transfer) {
+        this->transfer = transfer;
+    }
+
+    int get_priority() const {
+        return priority;
+    }
+
+    /**
+     * @brief Sets the priority; the thread also starts over at that MLFQ level.
+     */
+    void set_priority(int priority) {
+        this->priority = priority;
+        level = priority;
+    }
+
+    uint64_t get_runtime() const {
+        return runtime;
+    }
+
+    void add_runtime(uint64_t ns) {
+        runtime += ns;
+    }
+
+    int get_weight() const {
+        return weight;
+    }
+
+    void set_weight(int weight) {
+        this->weight = weight;
+    }
+
+    bool is_real_time() const {
+        return period > 0;
     }
 
-    ~Thread() {
-        delete[] this->t_stack;
+    /**
+     * @brief Makes the thread real-time with the given period and budget (nanoseconds); its first job is released
+     * at time release. A period of 0 makes it an ordinary thread again.
+     */
+    void set_deadline(uint64_t period, uint64_t budget, uint64_t release) {
+        this->period = period;
+        this->budget = budget;
+        deadline = release + period;
+        job_start = runtime;
     }
+
+    /**
+     * @brief Ends the current job at time now and releases the next one. A job that ends after its deadline
+     * counts as a miss, and the jobs whose release it overran are skipped.
+     *
+     * @return The release time of the next job: the current deadline, or the first period boundary after now.
+     */
+    uint64_t next_job(uint64_t now) {
+        uint64_t release = deadline;
+        if (now > deadline) {
+            deadline_misses++;
+            release += (now - deadline + period - 1) / period * period;
+        }
+        deadline = release + period;
+        job_start = runtime;
+        return release;
+    }
+
+    /**
+     * @brief The part of the current job's budget the thread has not used yet; 0 if it is not real-time.
+     */
+    uint64_t budget_left() const {
+        uint64_t used = runtime - job_start;
+        return is_real_time() && used < budget ? budget - used : 0;
+    }
+
+    long get_deadline_misses() const {
+        return deadline_misses;
+    }
+
+    bool is_queued() const {
+        return entries.load(std::memory_order_acquire) > 0;
+    }
+
+    void add_entry() {
+        entries.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @return The entries left.
+     */
+    int drop_entry() {
+        return entries.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    }
+
+#ifdef UTHREADS_ASM_SWITCH
+    Context *get_context() {
+        return &context;
+    }
+#else
+    sigjmp_buf* get_env() {
+        return &env;
+    }
+#endif
 };
 
 #endif //_THREAD_H_
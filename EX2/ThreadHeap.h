@@ -0,0 +1,129 @@
+#ifndef _THREAD_HEAP_H_
+#define _THREAD_HEAP_H_
+
+#include <vector>
+#include "Thread.h"
+
+/**
+ * @brief Binary min-heap of threads ordered by Before, in which every thread remembers its slot (the Thread member
+ * Index, -1 while it is not in the heap), so one can be taken out of the middle in O(log n).
+ *
+ * The heaps of SleepQueue, CfsPolicy and EdfPolicy; each passes its own order and slot member, which it owns in
+ * Thread. Threads that share a slot member (the sleep queues) are told apart by contains.
+ */
+template <bool (*Before)(const Thread *, const Thread *), int Thread::*Index>
+class ThreadHeap {
+private:
+    std::vector<Thread *> heap;
+
+    void place(int index, Thread *thread) {
+        heap[index] = thread;
+        thread->*Index = index;
+    }
+
+    void sift_up(int index) {
+        Thread *thread = heap[index];
+        while (index > 0) {
+            int parent = (index - 1) / 2;
+            if (!Before(thread, heap[parent])) {
+                break;
+            }
+            place(index, heap[parent]);
+            index = parent;
+        }
+        place(index, thread);
+    }
+
+    void sift_down(int index) {
+        Thread *thread = heap[index];
+        int size = (int) heap.size();
+        while (true) {
+            int child = 2 * index + 1;
+            if (child >= size) {
+                break;
+            }
+            if (child + 1 < size && Before(heap[child + 1], heap[child])) {
+                child++;
+            }
+            if (!Before(heap[child], thread)) {
+                break;
+            }
+            place(index, heap[child]);
+            index = child;
+        }
+        place(index, thread);
+    }
+
+public:
+    /**
+     * @brief Reserves room for capacity threads, so push never allocates afterwards.
+     */
+    void reserve(int capacity) {
+        heap.reserve(capacity);
+    }
+
+    bool empty() const {
+        return heap.empty();
+    }
+
+    int size() const {
+        return (int) heap.size();
+    }
+
+    /**
+     * @return The first thread in Before order. The heap must not be empty.
+     */
+    Thread *top() const {
+        return heap.front();
+    }
+
+    /**
+     * @brief True if thread is in this heap (and not in another one with the same slot member).
+     */
+    bool contains(const Thread *thread) const {
+        int index = thread->*Index;
+        return index >= 0 && index < (int) heap.size() && heap[index] == thread;
+    }
+
+    void push(Thread *thread) {
+        heap.push_back(thread);
+        sift_up((int) heap.size() - 1);
+    }
+
+    /**
+     * @brief Takes the first thread off the heap.
+     *
+     * @return The thread, or nullptr if the heap is empty.
+     */
+    Thread *pop() {
+        if (heap.empty()) {
+            return nullptr;
+        }
+        Thread *thread = heap.front();
+        erase(thread);
+        return thread;
+    }
+
+    /**
+     * @brief Removes thread from the heap.
+     *
+     * @return true if it was in the heap, false otherwise.
+     */
+    bool erase(Thread *thread) {
+        if (!contains(thread)) {
+            return false;
+        }
+        int index = thread->*Index;
+        Thread *last = heap.back();
+        heap.pop_back();
+        thread->*Index = -1;
+        if (last != thread) {
+            place(index, last);
+            sift_up(index);
+            sift_down(last->*Index);
+        }
+        return true;
+    }
+};
+
+#endif //_THREAD_HEAP_H_
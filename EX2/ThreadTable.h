@@ -0,0 +1,52 @@
+#ifndef _THREAD_TABLE_H_
+#define _THREAD_TABLE_H_
+
+#include <vector>
+#include "Thread.h"
+
+#define TABLE_CHUNK_SHIFT 8
+#define TABLE_CHUNK_SIZE (1 << TABLE_CHUNK_SHIFT)
+#define TABLE_CHUNK_MASK (TABLE_CHUNK_SIZE - 1)
+
+/**
+ * @brief tid -> Thread* map for up to a runtime-chosen number of threads.
+ *
+ * The directory of chunk pointers is sized once by init(); a chunk of TABLE_CHUNK_SIZE slots is only allocated
+ * when a tid in it is first used, so a large limit costs nothing until threads actually exist. Lookup is two
+ * loads and never allocates (safe from the signal handler), and Thread objects never move.
+ */
+class ThreadTable {
+private:
+    int capacity;
+    std::vector<Thread **> chunks;
+
+public:
+    ThreadTable() : capacity(0) {}
+
+    void init(int capacity) {
+        this->capacity = capacity;
+        chunks.assign((capacity + TABLE_CHUNK_MASK) >> TABLE_CHUNK_SHIFT, nullptr);
+    }
+
+    int get_capacity() const {
+        return capacity;
+    }
+
+    /**
+     * @return The thread with ID tid, or nullptr if there is none. tid must be in [0, capacity).
+     */
+    Thread *operator[](int tid) const {
+        Thread **chunk = chunks[tid >> TABLE_CHUNK_SHIFT];
+        return chunk != nullptr ? chunk[tid & TABLE_CHUNK_MASK] : nullptr;
+    }
+
+    void set(int tid, Thread *thread) {
+        Thread **&chunk = chunks[tid >> TABLE_CHUNK_SHIFT];
+        if (chunk == nullptr) {
+            chunk = new Thread *[TABLE_CHUNK_SIZE]();
+        }
+        chunk[tid & TABLE_CHUNK_MASK] = thread;
+    }
+};
+
+#endif //_THREAD_TABLE_H_
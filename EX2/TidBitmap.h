@@ -0,0 +1,95 @@
+#ifndef _TID_BITMAP_H_
+#define _TID_BITMAP_H_
+
+#include <stdint.h>
+#include <vector>
+
+#define BITMAP_WORD_BITS 64
+#define BITMAP_WORD_SHIFT 6
+#define BITMAP_WORD_MASK (BITMAP_WORD_BITS - 1)
+
+/**
+ * @brief Hierarchical bitmap of free thread IDs.
+ *
+ * Level 0 holds one bit per ID (1 == free). Every bit of level k + 1 summarises one word of level k and is set
+ * iff that word still has a free ID. Looking for the smallest free ID descends from the single top word using
+ * count-trailing-zeros, so acquire and release both cost one word per level (3 levels cover 262144 IDs).
+ */
+class TidBitmap {
+private:
+    int capacity;
+    std::vector<std::vector<uint64_t> > levels;
+
+    static int words_for(int bits) {
+        return (bits + BITMAP_WORD_MASK) >> BITMAP_WORD_SHIFT;
+    }
+
+    /**
+     * @brief Marks id as taken, clearing summary bits of words that became full.
+     */
+    void clear_bit(int id) {
+        for (size_t level = 0; level < levels.size(); level++) {
+            uint64_t &word = levels[level][id >> BITMAP_WORD_SHIFT];
+            word &= ~(1ULL << (id & BITMAP_WORD_MASK));
+            if (word != 0) {
+                return;
+            }
+            id >>= BITMAP_WORD_SHIFT;
+        }
+    }
+
+public:
+    explicit TidBitmap(int capacity) : capacity(capacity) {
+        int bits = capacity;
+        do {
+            levels.push_back(std::vector<uint64_t>(words_for(bits), 0));
+            bits = words_for(bits);
+        } while (bits > 1);
+        for (int id = 0; id < capacity; id++) {
+            release(id);
+        }
+    }
+
+    /**
+     * @brief Takes the smallest free ID.
+     *
+     * @return The ID, or -1 if every ID is in use.
+     */
+    int acquire() {
+        uint64_t top = levels.back()[0];
+        if (top == 0) {
+            return -1;
+        }
+        int id = __builtin_ctzll(top);
+        for (int level = (int) levels.size() - 2; level >= 0; level--) {
+            id = (id << BITMAP_WORD_SHIFT) | __builtin_ctzll(levels[level][id]);
+        }
+        clear_bit(id);
+        return id;
+    }
+
+    /**
+     * @brief Returns id to the free set.
+     */
+    void release(int id) {
+        for (size_t level = 0; level < levels.size(); level++) {
+            uint64_t &word = levels[level][id >> BITMAP_WORD_SHIFT];
+            bool was_full = (word == 0);
+            word |= 1ULL << (id & BITMAP_WORD_MASK);
+            if (!was_full) {
+                return;
+            }
+            id >>= BITMAP_WORD_SHIFT;
+        }
+    }
+
+    bool is_free(int id) const {
+        return (levels[0][id >> BITMAP_WORD_SHIFT] >> (id & BITMAP_WORD_MASK)) & 1;
+    }
+
+    int get_capacity() const {
+        return capacity;
+    }
+};
+
+#endif //_TID_BITMAP_H_
@@ -0,0 +1,214 @@
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
+#ifndef UTHREADS_TRACE_EVENTS
+#define UTHREADS_TRACE_EVENTS 65536 /* events kept per worker, the latest ones; a power of two */
+#endif
+
+/**
+ * @brief What happened to a thread, as recorded in a TraceBuffer.
+ */
+enum TraceType : uint16_t {
+    TRACE_SPAWN,     // the thread was created
+    TRACE_SWITCH,    // a worker switched from thread other to the thread
+    TRACE_BLOCK,     // uthread_block
+    TRACE_RESUME,    // uthread_resume
+    TRACE_SLEEP,     // went to sleep: uthread_sleep, uthread_sleep_for/until, uthread_wait_period
+    TRACE_WAKE,      // its sleep ended
+    TRACE_TERMINATE, // uthread_terminate
+    TRACE_TYPES
+};
+
+struct TraceEvent {
+    uint64_t tsc;    // time stamp counter when it happened
+    int32_t tid;     // the thread it happened to (for TRACE_SWITCH, the one switched in)
+    int32_t other;   // TRACE_SWITCH: the thread switched out
+    uint16_t type;   // a TraceType
+    uint16_t worker; // the worker it happened on
+};
+
+/**
+ * @brief Fixed-size rings of scheduler events, one per worker, for a timeline of what the threads did
+ * (uthread_trace_dump).
+ *
+ * Compiled into the library only with -DUTHREADS_TRACE. All the rings are allocated up front by start(), so
+ * recording allocates nothing, and it is wait-free: a worker only ever records into its own ring, so claiming a
+ * slot is a plain load and store of the ring's head, not an atomic read-modify-write. That also makes it safe in
+ * the timer handler, which never records while the same worker is already inside the library. Once full, a ring
+ * overwrites its oldest events. Time is the raw TSC, which the dump converts to microseconds by timing it against
+ * CLOCK_MONOTONIC from start() on, and on which it merges the rings.
+ */
+class TraceBuffer {
+private:
+    static_assert((UTHREADS_TRACE_EVENTS & (UTHREADS_TRACE_EVENTS - 1)) == 0,
+                  "UTHREADS_TRACE_EVENTS must be a power of two");
+
+    // a ring's head, alone on its cache line so the workers do not share one
+    struct Head {
+        std::atomic<uint64_t> next;
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    TraceEvent *events; // ring w is events[w * UTHREADS_TRACE_EVENTS ...]
+    Head *heads;
+    int rings;
+    uint64_t start_tsc;
+    uint64_t start_ns;
+
+    static uint64_t monotonic_ns() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+    }
+
+    static const char *name(uint16_t type) {
+        static const char *names[TRACE_TYPES] = {"spawn", "switch", "block", "resume", "sleep", "wake", "terminate"};
+        return type < TRACE_TYPES ? names[type] : "unknown";
+    }
+
+public:
+    TraceBuffer() : events(nullptr), heads(nullptr), rings(0), start_tsc(0), start_ns(0) {}
+
+    ~TraceBuffer() {
+        delete[] events;
+        delete[] heads;
+    }
+
+    static uint64_t now() {
+#ifdef __x86_64__
+        return __rdtsc();
+#else
+        return monotonic_ns();
+#endif
+    }
+
+    /**
+     * @brief Allocates a ring for each of workers workers and starts the clock the events are timed on.
+     */
+    void start(int workers) {
+        events = new TraceEvent[(size_t) workers * UTHREADS_TRACE_EVENTS]();
+        heads = new Head[workers]();
+        rings = workers;
+        start_ns = monotonic_ns();
+        start_tsc = now();
+    }
+
+    /**
+     * @brief Records an event into worker's ring. Only worker itself may call it.
+     */
+    void record(TraceType type, int tid, int other, int worker) {
+        std::atomic<uint64_t> &head = heads[worker].next;
+        uint64_t index = head.load(std::memory_order_relaxed);
+        TraceEvent &event = events[(size_t) worker * UTHREADS_TRACE_EVENTS + (index & (UTHREADS_TRACE_EVENTS - 1))];
+        event.tsc = now();
+        event.tid = tid;
+        event.other = other;
+        event.type = type;
+        event.worker = (uint16_t) worker;
+        head.store(index + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Number of events recorded so far by all workers, including the ones overwritten since.
+     */
+    uint64_t recorded() const {
+        uint64_t count = 0;
+        for (int worker = 0; worker < rings; worker++) {
+            count += heads[worker].next.load(std::memory_order_acquire);
+        }
+        return count;
+    }
+
+    /**
+     * @brief Room a snapshot needs: every ring full.
+     */
+    size_t capacity() const {
+        return (size_t) rings * UTHREADS_TRACE_EVENTS;
+    }
+
+    /**
+     * @brief Copies the events still in the rings to copy, ring by ring. An event being recorded meanwhile by
+     * another worker may be torn, so the caller keeps the other workers out of the scheduler; reserving capacity()
+     * first keeps that short, the copy then allocates nothing.
+     */
+    void snapshot(std::vector<TraceEvent> &copy) const {
+        copy.clear();
+        for (int worker = 0; worker < rings; worker++) {
+            uint64_t end = heads[worker].next.load(std::memory_order_acquire);
+            uint64_t begin = end > UTHREADS_TRACE_EVENTS ? end - UTHREADS_TRACE_EVENTS : 0;
+            for (uint64_t i = begin; i < end; i++) {
+                copy.push_back(events[(size_t) worker * UTHREADS_TRACE_EVENTS + (i & (UTHREADS_TRACE_EVENTS - 1))]);
+            }
+        }
+    }
+
+    /**
+     * @brief Writes a snapshot of the rings to out as Chrome trace JSON (chrome://tracing, ui.perfetto.dev).
+     *
+     * Every thread is a track: a switch ends the running slice of the thread switched out and begins one for the
+     * thread switched in, the other events are instants on the thread's track. Only threads with tid >= 0 get
+     * tracks (not the workers' idle threads). The rings are merged in time order, sorting merged in place. Only the
+     * snapshot is read, so the workers may go on recording meanwhile.
+     *
+     * @return false if writing failed.
+     */
+    bool write_chrome_json(std::vector<TraceEvent> &merged, FILE *out) const {
+        std::stable_sort(merged.begin(), merged.end(), [](const TraceEvent &a, const TraceEvent &b) {
+            return (int64_t) (a.tsc - b.tsc) < 0;
+        });
+        uint64_t ticks = now() - start_tsc;
+        double us_per_tick = ticks != 0 ? (monotonic_ns() - start_ns) / 1e3 / ticks : 0;
+        std::vector<bool> named;
+        fprintf(out, "{\"traceEvents\":[\n");
+        bool first = true;
+        auto separator = [&first]() {
+            const char *separator = first ? "" : ",\n";
+            first = false;
+            return separator;
+        };
+        for (const TraceEvent &event : merged) {
+            double ts = (double) (int64_t) (event.tsc - start_tsc) * us_per_tick;
+            int tids[2] = {event.tid, event.type == TRACE_SWITCH ? event.other : -1};
+            for (int tid : tids) {
+                if (tid < 0) {
+                    continue;
+                }
+                if ((int) named.size() <= tid) {
+                    named.resize(tid + 1, false);
+                }
+                if (!named[tid]) {
+                    named[tid] = true;
+                    fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                                 "\"args\":{\"name\":\"uthread %d\"}}", separator(), tid, tid);
+                }
+            }
+            if (event.type == TRACE_SWITCH) {
+                if (event.other >= 0) {
+                    fprintf(out, "%s{\"name\":\"run\",\"ph\":\"E\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}", separator(),
+                            ts, event.other);
+                }
+                if (event.tid >= 0) {
+                    fprintf(out, "%s{\"name\":\"run\",\"ph\":\"B\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,"
+                                 "\"args\":{\"worker\":%d}}", separator(), ts, event.tid, event.worker);
+                }
+            } else if (event.tid >= 0) {
+                fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,"
+                             "\"args\":{\"worker\":%d}}", separator(), name(event.type), ts, event.tid, event.worker);
+            }
+        }
+        fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+        return !ferror(out);
+    }
+};
+
+#endif //_TRACE_H_
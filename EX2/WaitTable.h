@@ -0,0 +1,129 @@
+#ifndef _WAIT_TABLE_H_
+#define _WAIT_TABLE_H_
+
+#include <stdint.h>
+#include <vector>
+#include "Thread.h"
+#include "ReadyQueue.h"
+
+/**
+ * @brief Hash table of wait queues keyed on an address, for uthread_wait/uthread_wake.
+ *
+ * A bucket chains one entry per address that has waiters, and every entry is a FIFO of its threads, so a wake
+ * only touches the threads it wakes (plus the few other addresses hashing to the same bucket), never every
+ * waiter. Each waiting thread remembers its address (Thread::wait_addr) so that it can be taken out when it is
+ * terminated. An entry is recycled as soon as its last waiter leaves; recycled entries are kept for reuse, so
+ * allocation only happens while the number of addresses waited on at once grows.
+ */
+class WaitTable {
+private:
+    struct Entry {
+        const void *addr;
+        ReadyQueue waiters;
+        Entry *next;
+    };
+
+    std::vector<Entry *> buckets;
+    int shift;
+    Entry *spare;
+
+    Entry *&bucket(const void *addr) {
+        // Fibonacci hashing: the top bits of the product depend on all bits of the address
+        return buckets[((uintptr_t) addr * 0x9E3779B97F4A7C15ULL) >> shift];
+    }
+
+    /**
+     * @return The link pointing at the entry of addr (the bucket head or the previous entry's next), or at the
+     * null link at the end of the chain if nobody waits on addr.
+     */
+    Entry **find(const void *addr) {
+        Entry **link = &bucket(addr);
+        while (*link != nullptr && (*link)->addr != addr) {
+            link = &(*link)->next;
+        }
+        return link;
+    }
+
+    /**
+     * @brief Recycles the entry *link points at if its last waiter left.
+     */
+    void release_if_empty(Entry **link) {
+        Entry *entry = *link;
+        if (entry->waiters.empty()) {
+            *link = entry->next;
+            entry->next = spare;
+            spare = entry;
+        }
+    }
+
+public:
+    WaitTable() : shift(63), spare(nullptr) {}
+
+    /**
+     * @brief Sizes the table for about capacity addresses waited on at once.
+     */
+    void init(int capacity) {
+        int bits = 1;
+        while ((1 << bits) < capacity) {
+            bits++;
+        }
+        buckets.assign(1 << bits, nullptr);
+        shift = 64 - bits;
+    }
+
+    /**
+     * @brief Records that thread waits on addr.
+     *
+     * @return The queue the thread must be appended to.
+     */
+    ReadyQueue *enqueue(Thread *thread, const void *addr) {
+        Entry **link = find(addr);
+        if (*link == nullptr) {
+            Entry *entry = spare;
+            if (entry != nullptr) {
+                spare = entry->next;
+            } else {
+                entry = new Entry();
+            }
+            entry->addr = addr;
+            entry->next = nullptr;
+            *link = entry;
+        }
+        thread->wait_addr = addr;
+        return &(*link)->waiters;
+    }
+
+    /**
+     * @brief Takes the first thread waiting on addr off its queue.
+     *
+     * @return The thread, or nullptr if nobody waits on addr.
+     */
+    Thread *pop(const void *addr) {
+        Entry **link = find(addr);
+        if (*link == nullptr) {
+            return nullptr;
+        }
+        Thread *thread = (*link)->waiters.pop_front();
+        thread->wait_addr = nullptr;
+        release_if_empty(link);
+        return thread;
+    }
+
+    /**
+     * @brief Takes thread off the queue of the address it waits on.
+     *
+     * @return true if the thread was waiting on an address, false otherwise.
+     */
+    bool erase(Thread *thread) {
+        if (thread->wait_addr == nullptr) {
+            return false;
+        }
+        Entry **link = find(thread->wait_addr);
+        (*link)->waiters.erase(thread);
+        thread->wait_addr = nullptr;
+        release_if_empty(link);
+        return true;
+    }
+};
+
+#endif //_WAIT_TABLE_H_
@@ -0,0 +1,97 @@
+#ifndef _WORK_STEALING_DEQUE_H_
+#define _WORK_STEALING_DEQUE_H_
+
+#include <atomic>
+#include <vector>
+#include "Thread.h"
+
+/**
+ * @brief Chase-Lev work-stealing deque of READY threads, one per worker.
+ *
+ * Only the owning worker pushes, at the bottom; anybody (the owner included) takes from the top with a CAS,
+ * the steal operation of Chase and Lev (with the C11 orderings of Le et al.). The owner does not use the LIFO
+ * pop at the bottom: a time-sharing scheduler must run its threads round-robin, so its own queue is FIFO too,
+ * and a thief takes the thread that has waited longest.
+ *
+ * The ring never grows: reserve() sizes it once, before any thread runs, so that push never allocates (it is
+ * called from the timer handler). The owner must check size() against capacity() before pushing.
+ *
+ * A worker switching between deque threads holds only its own share of the scheduler lock (see SchedLock), so
+ * the owner's push and take and other workers' steals really do run at the same time; the deque and the threads'
+ * atomic state (Thread::claim) are all that keeps them apart.
+ */
+class WorkStealingDeque {
+private:
+    std::atomic<long> top;
+    std::atomic<long> bottom;
+    std::vector<std::atomic<Thread *> > slots;
+    long mask;
+
+public:
+    WorkStealingDeque() : top(0), bottom(0), mask(0) {}
+
+    /**
+     * @brief Sizes the ring for at least capacity entries. Only while the deque is empty and unshared.
+     */
+    void reserve(int capacity) {
+        long size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots = std::vector<std::atomic<Thread *> >(size);
+        mask = size - 1;
+    }
+
+    /**
+     * @brief Appends thread at the bottom. Owner only.
+     */
+    void push(Thread *thread) {
+        long b = bottom.load(std::memory_order_relaxed);
+        slots[b & mask].store(thread, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Takes the thread at the top. Safe from any worker.
+     *
+     * @return The thread, or nullptr if the deque was empty.
+     */
+    Thread *steal() {
+        while (true) {
+            long t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            long b = bottom.load(std::memory_order_acquire);
+            if (t >= b) {
+                return nullptr;
+            }
+            Thread *thread = slots[t & mask].load(std::memory_order_relaxed);
+            if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return thread;
+            }
+            // lost the race for this entry to another taker: try the next one
+        }
+    }
+
+    /**
+     * @return true if the deque looked empty at some point during the call.
+     */
+    bool empty() const {
+        return top.load(std::memory_order_acquire) >= bottom.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @return The number of entries; exact for the owner as long as nobody steals, an upper bound otherwise.
+     */
+    long size() const {
+        long t = top.load(std::memory_order_acquire);
+        long b = bottom.load(std::memory_order_acquire);
+        return b > t ? b - t : 0;
+    }
+
+    long capacity() const {
+        return mask + 1;
+    }
+};
+
+#endif //_WORK_STEALING_DEQUE_H_
@@ -0,0 +1,43 @@
+#ifndef _WORKER_H_
+#define _WORKER_H_
+
+#include <pthread.h>
+#include <time.h>
+#include "Thread.h"
+#include "WorkStealingDeque.h"
+
+#define WAKE_STACK_SIZE (16 * 1024)
+
+/**
+ * @brief A kernel thread running uthreads: its run queue and what it needs to switch between them.
+ *
+ * Worker 0 is the thread that called uthread_init; the others are pthreads started by it. With several workers
+ * and a FIFO policy, READY threads wait on the worker's deque, which only its worker pushes to and which the other
+ * workers steal from when they run out of work; otherwise they share the library's run queue. The rest is only
+ * touched by the worker itself, under its share of the scheduler lock (see SchedLock), except that
+ * uthread_get_total_quantums and friends read other workers' fields under the whole lock.
+ */
+struct Worker {
+    int index;
+    pthread_t pthread;
+    timer_t timer;           // CPU-time quantum timer of this kernel thread (several workers only)
+    clockid_t cpu_clock;     // the CPU clock of this kernel thread, which that timer runs on
+    bool tickless;           // the timer is disarmed: the running thread has the CPU to itself (see go_tickless)
+    uint64_t tickless_since; // worker_cpu_ns from which the quantums skipped while tickless are counted
+    WorkStealingDeque deque; // threads waiting to run here (work-stealing mode)
+    long steals;             // threads this worker took from another worker's deque
+    Thread *run_next;        // woken by a channel operation here: runs before the queue if the waker parks
+    Thread *idle;            // runs when nothing else is runnable; never queued and not in the thread table
+    Thread *dead;            // terminated thread switched away from here, freed once we are off its stack
+    Thread *requeue;         // runnable thread switched away from here, queued once its context is saved (deques)
+    uint64_t run_start;      // CLOCK_MONOTONIC ns up to which the running thread's runtime is charged
+    char wake_stack[WAKE_STACK_SIZE]; // alternate signal stack of this kernel thread (see set_wake_stack)
+#ifdef UTHREADS_ASM_SWITCH
+    Context dead_context;    // scratch save area when switching away from a terminated thread
+#endif
+
+    Worker() : index(0), pthread(), timer(), cpu_clock(CLOCK_THREAD_CPUTIME_ID), tickless(false), tickless_since(0),
+               steals(0), run_next(nullptr), idle(nullptr), dead(nullptr), requeue(nullptr), run_start(0) {}
+};
+
+#endif //_WORKER_H_
@@ -0,0 +1,27 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * Converts the struct timespec to time in nano-seconds.
+ * @param t - the struct timespec to convert.
+ * @return - the value of time in nano-seconds.
+ */
+static inline uint64_t nanosectime(struct timespec t)
+{
+    return t.tv_nsec + t.tv_sec * 1000000000ULL;
+}
+
+/**
+ * @return - the current CLOCK_MONOTONIC time in nano-seconds.
+ */
+static inline uint64_t now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return nanosectime(t);
+}
+
+#endif //_BENCH_H_
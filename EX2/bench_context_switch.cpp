@@ -0,0 +1,98 @@
+/*
+ * bench_context_switch.cpp - context switch latency, hand-written switch vs. sigsetjmp/siglongjmp.
+ *
+ * Part 1 times the raw primitives: a context_switch round trip between two stacks, and a
+ * sigsetjmp(env, 1) + siglongjmp pair (each of which is an rt_sigprocmask system call).
+ * Part 2 times a full library switch between two uthreads driven by SIGVTALRM. "make bench" builds this file
+ * twice: bench_context_switch uses the assembly switch and bench_context_switch_jmpbuf the jmpbuf fallback.
+ *
+ * Output is CSV: which,ns_per_switch
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <setjmp.h>
+#include <unistd.h>
+#include "bench.h"
+#include "Context.h"
+#include "uthreads.h"
+
+#define SWITCHES 1000000
+#define LIB_SWITCHES 100000
+#define BENCH_QUANTUM 100000000 /* long enough that the timer never fires by itself */
+#define CO_STACK_SIZE 65536
+
+#ifdef UTHREADS_ASM_SWITCH
+#define LIB_MODE "asm"
+#else
+#define LIB_MODE "jmpbuf"
+#endif
+
+#ifdef __x86_64__
+static Context main_ctx;
+static Context co_ctx;
+static char co_stack[CO_STACK_SIZE];
+
+static void co_loop(void)
+{
+    while (1) {
+        context_switch(&co_ctx, &main_ctx);
+    }
+}
+
+static double raw_context_switch()
+{
+    context_init(&co_ctx, co_stack, CO_STACK_SIZE, co_loop);
+    uint64_t start = now_ns();
+    for (int i = 0; i < SWITCHES; i++) {
+        context_switch(&main_ctx, &co_ctx);
+    }
+    return (double) (now_ns() - start) / (2.0 * SWITCHES);
+}
+#endif
+
+static double raw_sigjmp()
+{
+    static sigjmp_buf env;
+    uint64_t start = now_ns();
+    for (volatile int i = 0; i < SWITCHES; i++) {
+        if (sigsetjmp(env, 1) == 0) {
+            siglongjmp(env, 1);
+        }
+    }
+    return (double) (now_ns() - start) / SWITCHES;
+}
+
+static void bouncer(void)
+{
+    while (1) {
+        kill(getpid(), SIGVTALRM);
+    }
+}
+
+static double library_switch()
+{
+    int tid = uthread_spawn(bouncer);
+    kill(getpid(), SIGVTALRM);
+    uint64_t start = now_ns();
+    for (int i = 0; i < LIB_SWITCHES; i++) {
+        kill(getpid(), SIGVTALRM);
+    }
+    double result = (double) (now_ns() - start) / (2.0 * LIB_SWITCHES);
+    uthread_terminate(tid);
+    return result;
+}
+
+int main(void)
+{
+    printf("which,ns_per_switch\n");
+#ifdef __x86_64__
+    printf("raw_context_switch,%.2f\n", raw_context_switch());
+#endif
+    printf("raw_sigsetjmp_siglongjmp,%.2f\n", raw_sigjmp());
+
+    uthread_init(BENCH_QUANTUM);
+    printf("uthreads_sigvtalrm_switch_%s,%.2f\n", LIB_MODE, library_switch());
+    uthread_terminate(0);
+    return 0;
+}
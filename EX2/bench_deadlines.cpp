@@ -0,0 +1,124 @@
+/*
+ * bench_deadlines.cpp - deadline misses of periodic real-time threads (uthread_set_deadline) under CPU load.
+ *
+ * TASKS periodic threads share the CPU with BACKGROUND threads that burn it non-stop. Task i has period
+ * PERIODS_MS[i]; every job burns a fixed amount of the task's own run time (uthread_get_runtime), chosen so that
+ * the tasks together need the given utilization of the CPU, and then calls uthread_wait_period. Its budget is
+ * BUDGET_SLACK times that cost. Each utilization level runs for RUN_MS, timed by a real-time thread whose single
+ * period is that long; the miss rate is the share of jobs that ended after their deadline. Under the EDF policy
+ * it should stay near 0 up to a utilization of 1 (less what the background threads take in the quantums of
+ * timer granularity); the other policies make every job wait its turn behind the background threads.
+ *
+ * Built once per policy like bench_policies (make bench-deadlines).
+ * Output is CSV: policy,background,utilization,jobs,misses,miss_rate_pct
+ */
+
+#include <stdio.h>
+#include "uthreads.h"
+
+#ifndef BENCH_POLICY
+#define BENCH_POLICY "default"
+#endif
+
+#define TASKS 4
+#define BACKGROUND 2
+#define RUN_MS 2000
+#define BUDGET_SLACK 1.2
+#define BENCH_QUANTUM 1000
+#define USEC_PER_MSEC 1000
+
+static const int PERIODS_MS[TASKS] = {20, 30, 50, 80};
+static const double UTILIZATIONS[] = {0.3, 0.5, 0.7, 0.9};
+
+static long costs_ns[TASKS];
+static long jobs[TASKS];
+static int tids[TASKS];
+static long total_jobs;
+static long total_misses;
+static int next_task;
+static int finished;
+static volatile unsigned long sink;
+
+static void burn(unsigned long steps)
+{
+    unsigned long x = steps;
+    for (unsigned long i = 0; i < steps; i++) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+    }
+    sink = x;
+}
+
+static void background(void)
+{
+    while (true) {
+        burn(1000);
+    }
+}
+
+static void task(void)
+{
+    int index = next_task++;
+    int tid = uthread_get_tid();
+    while (true) {
+        long start = uthread_get_runtime(tid);
+        while (uthread_get_runtime(tid) - start < costs_ns[index]) {
+            burn(1000);
+        }
+        jobs[index]++;
+        uthread_wait_period();
+    }
+}
+
+static void timer(void)
+{
+    uthread_wait_period();
+    // counted here, on time: the main thread only gets to run behind the background threads
+    total_jobs = 0;
+    total_misses = 0;
+    for (int i = 0; i < TASKS; i++) {
+        total_jobs += jobs[i];
+        total_misses += uthread_get_deadline_misses(tids[i]);
+    }
+    finished = 1;
+    uthread_wake(&finished, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+int main(void)
+{
+    if (uthread_init(BENCH_QUANTUM, 1 + TASKS + BACKGROUND + 1) < 0) {
+        return 1;
+    }
+    printf("policy,background,utilization,jobs,misses,miss_rate_pct\n");
+    for (double utilization : UTILIZATIONS) {
+        finished = 0;
+        next_task = 0;
+        int background_tids[BACKGROUND];
+        for (int i = 0; i < BACKGROUND; i++) {
+            background_tids[i] = uthread_spawn(background);
+        }
+        for (int i = 0; i < TASKS; i++) {
+            int period_us = PERIODS_MS[i] * USEC_PER_MSEC;
+            costs_ns[i] = (long) (utilization / TASKS * period_us * 1000);
+            jobs[i] = 0;
+            tids[i] = uthread_spawn(task);
+            uthread_set_deadline(tids[i], period_us, (int) (costs_ns[i] / 1000 * BUDGET_SLACK));
+        }
+        int timer_tid = uthread_spawn(timer);
+        uthread_set_deadline(timer_tid, RUN_MS * USEC_PER_MSEC, 1);
+        // the main thread waits parked, out of the run queue
+        while (!finished) {
+            uthread_wait(&finished, 0);
+        }
+        for (int i = 0; i < TASKS; i++) {
+            uthread_terminate(tids[i]);
+        }
+        for (int i = 0; i < BACKGROUND; i++) {
+            uthread_terminate(background_tids[i]);
+        }
+        printf("%s,%d,%.2f,%ld,%ld,%.1f\n", BENCH_POLICY, BACKGROUND, utilization, total_jobs, total_misses,
+               total_jobs > 0 ? 100.0 * total_misses / total_jobs : 0.0);
+    }
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,141 @@
+/*
+ * bench_echo.cpp - loopback TCP echo server and its clients, all uthreads in one process, on the I/O wrappers.
+ *
+ * For each number of connections, an acceptor thread accepts them and spawns a handler thread per connection,
+ * which echoes whatever it reads (uthread_read/uthread_write) until the client closes. As many client threads
+ * connect (uthread_connect) and each sends ROUNDS requests of MESSAGE bytes, waiting for the whole echo before
+ * sending the next one. A request's latency runs from just before its write to the end of the echo; with every
+ * client in the same process it includes the time the request waits behind the other threads' turns. The
+ * throughput is over the whole run, connection setup included.
+ *
+ * Output is CSV: connections,requests,req_per_s,p50_us,p99_us
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <algorithm>
+#include <vector>
+#include "bench.h"
+#include "uthreads.h"
+
+#define ROUNDS 50
+#define MESSAGE 64
+#define BENCH_QUANTUM 10000
+
+static const int connection_counts[] = {10, 100, 1000, 2000};
+
+static int listen_fd;
+static struct sockaddr_in server_addr;
+static int connections;
+static int accepted_fds[2000];
+static int next_handler;
+static int next_client;
+static int clients_done;
+static int handlers_done;
+static uint64_t *latencies;
+
+static void finish(int *counter)
+{
+    (*counter)++;
+    uthread_wake(counter, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+static void handler(void)
+{
+    int fd = accepted_fds[__atomic_fetch_add(&next_handler, 1, __ATOMIC_RELAXED)];
+    char buf[MESSAGE];
+    ssize_t n;
+    while ((n = uthread_read(fd, buf, sizeof(buf))) > 0) {
+        uthread_write(fd, buf, n);
+    }
+    close(fd);
+    finish(&handlers_done);
+}
+
+static void acceptor(void)
+{
+    for (int i = 0; i < connections; i++) {
+        accepted_fds[i] = uthread_accept(listen_fd, NULL, NULL);
+        uthread_spawn(handler);
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+static void client(void)
+{
+    int index = __atomic_fetch_add(&next_client, 1, __ATOMIC_RELAXED);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    uthread_connect(fd, (struct sockaddr *) &server_addr, sizeof(server_addr));
+    char request[MESSAGE];
+    char reply[MESSAGE];
+    memset(request, 'x', sizeof(request));
+    for (int round = 0; round < ROUNDS; round++) {
+        uint64_t start = now_ns();
+        uthread_write(fd, request, sizeof(request));
+        size_t received = 0;
+        while (received < sizeof(reply)) {
+            ssize_t n = uthread_read(fd, reply + received, sizeof(reply) - received);
+            if (n <= 0) {
+                break;
+            }
+            received += n;
+        }
+        latencies[index * ROUNDS + round] = now_ns() - start;
+    }
+    close(fd);
+    finish(&clients_done);
+}
+
+int main(void)
+{
+    const int max_connections = connection_counts[sizeof(connection_counts) / sizeof(int) - 1];
+    if (uthread_init(BENCH_QUANTUM, 2 + 2 * max_connections) < 0) {
+        return 1;
+    }
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    server_addr.sin_port = 0;
+    socklen_t length = sizeof(server_addr);
+    if (bind(listen_fd, (struct sockaddr *) &server_addr, sizeof(server_addr)) < 0 || listen(listen_fd, SOMAXCONN) < 0 ||
+        getsockname(listen_fd, (struct sockaddr *) &server_addr, &length) < 0) {
+        perror("listen");
+        return 1;
+    }
+    std::vector<uint64_t> samples((size_t) max_connections * ROUNDS);
+    latencies = samples.data();
+    printf("connections,requests,req_per_s,p50_us,p99_us\n");
+    for (int count : connection_counts) {
+        connections = count;
+        next_handler = 0;
+        next_client = 0;
+        clients_done = 0;
+        handlers_done = 0;
+        uint64_t start = now_ns();
+        uthread_spawn(acceptor);
+        for (int i = 0; i < count; i++) {
+            uthread_spawn(client);
+        }
+        // the main thread waits parked, out of the run queue
+        while (clients_done < count) {
+            uthread_wait(&clients_done, clients_done);
+        }
+        double seconds = (now_ns() - start) / 1e9;
+        while (handlers_done < count) {
+            uthread_wait(&handlers_done, handlers_done);
+        }
+        const int requests = count * ROUNDS;
+        std::sort(latencies, latencies + requests);
+        printf("%d,%d,%.0f,%.1f,%.1f\n", count, requests, requests / seconds, latencies[requests / 2] / 1e3,
+               latencies[(int) (requests * 0.99)] / 1e3);
+    }
+    close(listen_fd);
+    uthread_terminate(0);
+    return 0;
+}
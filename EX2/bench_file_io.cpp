@@ -0,0 +1,143 @@
+/*
+ * bench_file_io.cpp - random 4 KiB reads of a local file at queue depths 1 to 256.
+ *
+ * A FILE_MB file is written in the current directory and read back with O_DIRECT, so every read goes to the disk
+ * (where O_DIRECT is refused, e.g. on tmpfs, the file is read through the page cache, dropped before each run).
+ * At queue depth d, d reader threads each read READS / d blocks at random aligned offsets, one at a time:
+ * - pread:          plain pread(2), which blocks the whole process, so the depth is 1 whatever d is;
+ * - uthread_pread:  the library's asynchronous reads, io_uring (or, in bench_file_io_iopool, the kernel thread
+ *                   pool fallback), so up to d reads are in flight at once.
+ * The latency of a read is from its call to its return, including the wait for the reader's next turn.
+ *
+ * Output is CSV: api,backend,queue_depth,reads,iops,p50_us,p99_us
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <vector>
+#include "bench.h"
+#include "uthreads.h"
+
+#ifdef UTHREADS_FILE_IO_THREADS
+#define BENCH_BACKEND "threads"
+#else
+#define BENCH_BACKEND "io_uring"
+#endif
+
+#define FILE_NAME "bench_file_io.dat"
+#define FILE_MB 256
+#define BLOCK 4096
+#define READS 8192
+#define MAX_DEPTH 256
+#define BENCH_QUANTUM 10000
+
+static const int depths[] = {1, 4, 16, 64, 256};
+
+static int file_fd;
+static bool direct;
+static bool use_uthreads;
+static int depth;
+static int next_reader;
+static int done;
+static uint64_t latencies[READS];
+static char *buffers;
+
+static void reader(void)
+{
+    int index = next_reader++;
+    char *buf = buffers + (size_t) index * BLOCK;
+    unsigned long x = 0x9e3779b97f4a7c15UL * (index + 1);
+    const int reads = READS / depth;
+    for (int i = 0; i < reads; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        off_t offset = (off_t) (x % ((uint64_t) FILE_MB * 1024 * 1024 / BLOCK)) * BLOCK;
+        uint64_t start = now_ns();
+        ssize_t n = use_uthreads ? uthread_pread(file_fd, buf, BLOCK, offset) : pread(file_fd, buf, BLOCK, offset);
+        if (n != BLOCK) {
+            perror("read");
+            exit(1);
+        }
+        latencies[index * reads + i] = now_ns() - start;
+    }
+    done++;
+    uthread_wake(&done, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+static bool create_file()
+{
+    int fd = open(FILE_NAME, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    std::vector<char> chunk(1024 * 1024);
+    for (size_t i = 0; i < chunk.size(); i++) {
+        chunk[i] = (char) (i * 131 + 7);
+    }
+    for (int mb = 0; mb < FILE_MB; mb++) {
+        if (write(fd, chunk.data(), chunk.size()) != (ssize_t) chunk.size()) {
+            close(fd);
+            return false;
+        }
+    }
+    fsync(fd);
+    close(fd);
+    file_fd = open(FILE_NAME, O_RDONLY | O_DIRECT);
+    direct = file_fd >= 0;
+    if (!direct) {
+        file_fd = open(FILE_NAME, O_RDONLY);
+    }
+    return file_fd >= 0;
+}
+
+static void run(bool uthreads, int queue_depth)
+{
+    if (!direct) {
+        posix_fadvise(file_fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    use_uthreads = uthreads;
+    depth = queue_depth;
+    next_reader = 0;
+    done = 0;
+    uint64_t start = now_ns();
+    for (int i = 0; i < depth; i++) {
+        uthread_spawn(reader);
+    }
+    // the main thread waits parked, out of the run queue
+    while (done < depth) {
+        uthread_wait(&done, done);
+    }
+    double seconds = (now_ns() - start) / 1e9;
+    const int reads = READS / depth * depth;
+    std::sort(latencies, latencies + reads);
+    printf("%s,%s,%d,%d,%.0f,%.1f,%.1f\n", uthreads ? "uthread_pread" : "pread", uthreads ? BENCH_BACKEND : "-",
+           depth, reads, reads / seconds, latencies[reads / 2] / 1e3, latencies[(int) (reads * 0.99)] / 1e3);
+}
+
+int main(void)
+{
+    if (uthread_init(BENCH_QUANTUM, 1 + MAX_DEPTH) < 0) {
+        return 1;
+    }
+    if (posix_memalign((void **) &buffers, BLOCK, (size_t) MAX_DEPTH * BLOCK) != 0 || !create_file()) {
+        perror(FILE_NAME);
+        unlink(FILE_NAME);
+        return 1;
+    }
+    printf("api,backend,queue_depth,reads,iops,p50_us,p99_us\n");
+    for (int queue_depth : depths) {
+        run(false, queue_depth);
+        run(true, queue_depth);
+    }
+    close(file_fd);
+    unlink(FILE_NAME);
+    free(buffers);
+    uthread_terminate(0);
+    return 0;
+}
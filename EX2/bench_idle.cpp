@@ -0,0 +1,103 @@
+/*
+ * bench_idle.cpp - CPU the process burns while every thread sleeps.
+ *
+ * Sleeping threads each go to sleep ROUNDS times and do a little work in between, while the main thread waits
+ * parked until they are all done, so the worker has nothing to run most of the time:
+ * - sleep:   one thread, uthread_sleep(SLEEP_QUANTUMS). Only one, since every switch starts a quantum: with more
+ *            sleepers their own switches would count down each other's sleeps;
+ * - period:  PERIODIC threads, uthread_wait_period with a period of PERIOD_US.
+ * The CPU time of the process (CLOCK_PROCESS_CPUTIME_ID) over the wall-clock time of the run shows how much of
+ * the idle time was spent spinning rather than sleeping. wall_per_round_ms shows that an idle quantum lasts a
+ * quantum of real time.
+ *
+ * Output is CSV: case,sleepers,wall_ms,cpu_ms,cpu_pct,wall_per_round_ms
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "bench.h"
+#include "uthreads.h"
+
+#define PERIODIC 16
+#define ROUNDS 200
+#define SLEEP_QUANTUMS 5
+#define PERIOD_US 5000
+#define WORK 2000
+#define BENCH_QUANTUM 1000
+
+static int done;
+static volatile unsigned long sink;
+
+static void work(void)
+{
+    unsigned long x = uthread_get_tid();
+    for (int i = 0; i < WORK; i++) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+    }
+    sink = x;
+}
+
+static void finish(void)
+{
+    done++;
+    uthread_wake(&done, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+static void sleeper(void)
+{
+    for (int i = 0; i < ROUNDS; i++) {
+        uthread_sleep(SLEEP_QUANTUMS);
+        work();
+    }
+    finish();
+}
+
+static void periodic(void)
+{
+    for (int i = 0; i < ROUNDS; i++) {
+        uthread_wait_period();
+        work();
+    }
+    finish();
+}
+
+static uint64_t cpu_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return nanosectime(t);
+}
+
+static void run(const char *name, void (*entry)(void), int sleepers, bool real_time)
+{
+    done = 0;
+    uint64_t wall = now_ns();
+    uint64_t cpu = cpu_ns();
+    for (int i = 0; i < sleepers; i++) {
+        int tid = uthread_spawn(entry);
+        if (real_time) {
+            uthread_set_deadline(tid, PERIOD_US, PERIOD_US / 2);
+        }
+    }
+    // the main thread waits parked, out of the run queue
+    while (done < sleepers) {
+        uthread_wait(&done, done);
+    }
+    wall = now_ns() - wall;
+    cpu = cpu_ns() - cpu;
+    printf("%s,%d,%.1f,%.1f,%.1f,%.2f\n", name, sleepers, wall / 1e6, cpu / 1e6, 100.0 * cpu / wall,
+           wall / 1e6 / ROUNDS);
+}
+
+int main(void)
+{
+    if (uthread_init(BENCH_QUANTUM, 1 + PERIODIC) < 0) {
+        return 1;
+    }
+    printf("case,sleepers,wall_ms,cpu_ms,cpu_pct,wall_per_round_ms\n");
+    run("sleep", sleeper, 1, false);
+    run("period", periodic, PERIODIC, true);
+    uthread_terminate(0);
+    return 0;
+}
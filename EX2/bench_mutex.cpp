@@ -0,0 +1,167 @@
+/*
+ * bench_mutex.cpp - contended lock throughput: uthread_mutex_t vs. spin-waiting.
+ *
+ * THREADS uthreads repeatedly take one lock, do CS_WORK steps of arithmetic under it and OUTSIDE_WORK steps
+ * outside it, under ordinary timer preemption. A holder preempted inside its critical section keeps the lock for
+ * a whole round of the others, which is what the lock kinds handle differently:
+ * - mutex:      uthread_mutex_lock parks the waiters, which take no quantums until the holder unlocks;
+ * - spin:       waiters spin on an atomic flag for the rest of their quantum;
+ * - spin_yield: waiters spin, but give up the CPU with uthread_yield after every failed attempt.
+ * uthread_init can only be called once per process, so every kind runs in a forked child that reports back
+ * through a pipe. Quantums are the total quantums the run took: the lower, the less CPU the waiters burnt. The main
+ * thread joins the contenders with a condition variable.
+ *
+ * Usage: bench_mutex [workers]   (default: 1)
+ * Output is CSV: lock,workers,threads,ms,ops_per_s,quantums
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <atomic>
+#include "bench.h"
+#include "uthreads.h"
+
+#define THREADS 8
+#define OPS_PER_THREAD 20000
+#define CS_WORK 2000
+#define OUTSIDE_WORK 2000
+#define BENCH_QUANTUM 1000
+
+enum LockKind { MUTEX, SPIN, SPIN_YIELD, LOCK_KINDS };
+
+static const char *lock_names[LOCK_KINDS] = {"mutex", "spin", "spin_yield"};
+
+struct Result {
+    uint64_t elapsed;
+    int quantums;
+};
+
+static LockKind kind;
+static uthread_mutex_t mutex = UTHREAD_MUTEX_INITIALIZER;
+static std::atomic<bool> spin_flag(false);
+static uthread_mutex_t join_mutex = UTHREAD_MUTEX_INITIALIZER;
+static uthread_cond_t join_cond = UTHREAD_COND_INITIALIZER;
+static int done = 0;
+static volatile unsigned long shared_state = 1;
+
+static void lock()
+{
+    switch (kind) {
+        case MUTEX:
+            uthread_mutex_lock(&mutex);
+            break;
+        case SPIN:
+            while (spin_flag.exchange(true, std::memory_order_acquire)) {
+                while (spin_flag.load(std::memory_order_relaxed)) {
+                }
+            }
+            break;
+        default:
+            while (spin_flag.exchange(true, std::memory_order_acquire)) {
+                uthread_yield();
+            }
+            break;
+    }
+}
+
+static void unlock()
+{
+    if (kind == MUTEX) {
+        uthread_mutex_unlock(&mutex);
+    } else {
+        spin_flag.store(false, std::memory_order_release);
+    }
+}
+
+static unsigned long work(unsigned long x, int steps)
+{
+    for (int i = 0; i < steps; i++) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+    }
+    return x;
+}
+
+static void contender(void)
+{
+    unsigned long x = (unsigned long) uthread_get_tid();
+    for (int op = 0; op < OPS_PER_THREAD; op++) {
+        lock();
+        shared_state = work(shared_state, CS_WORK);
+        unlock();
+        x = work(x, OUTSIDE_WORK);
+    }
+    if (x == 0) {
+        shared_state = 0;
+    }
+    uthread_mutex_lock(&join_mutex);
+    if (++done == THREADS) {
+        uthread_cond_signal(&join_cond);
+    }
+    uthread_mutex_unlock(&join_mutex);
+    uthread_terminate(uthread_get_tid());
+}
+
+/**
+ * Runs the workload with the given lock kind, in this (child) process.
+ * @return - false on failure.
+ */
+static bool run(int workers, Result *result)
+{
+    if (uthread_init(BENCH_QUANTUM, THREADS + 1, workers) < 0) {
+        return false;
+    }
+    uint64_t start = now_ns();
+    for (int i = 0; i < THREADS; i++) {
+        if (uthread_spawn(contender) < 0) {
+            return false;
+        }
+    }
+    // the main thread waits parked, so it takes no CPU from the contenders whatever the lock kind
+    uthread_mutex_lock(&join_mutex);
+    while (done < THREADS) {
+        uthread_cond_wait(&join_cond, &join_mutex);
+    }
+    uthread_mutex_unlock(&join_mutex);
+    result->elapsed = now_ns() - start;
+    result->quantums = uthread_get_total_quantums();
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int workers = argc > 1 ? atoi(argv[1]) : 1;
+    if (workers < 1) {
+        workers = 1;
+    }
+    printf("lock,workers,threads,ms,ops_per_s,quantums\n");
+    for (int k = 0; k < LOCK_KINDS; k++) {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            return 1;
+        }
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            kind = (LockKind) k;
+            Result result = {};
+            if (!run(workers, &result) || write(fds[1], &result, sizeof(result)) != sizeof(result)) {
+                _exit(1);
+            }
+            uthread_terminate(0);
+        }
+        close(fds[1]);
+        Result result;
+        if (read(fds[0], &result, sizeof(result)) != sizeof(result)) {
+            return 1;
+        }
+        close(fds[0]);
+        waitpid(pid, NULL, 0);
+        double seconds = result.elapsed / 1e9;
+        printf("%s,%d,%d,%.1f,%.0f,%d\n", lock_names[k], workers, THREADS, seconds * 1e3,
+               THREADS * (double) OPS_PER_THREAD / seconds, result.quantums);
+    }
+    return 0;
+}
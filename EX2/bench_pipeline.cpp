@@ -0,0 +1,132 @@
+/*
+ * bench_pipeline.cpp - channel pipeline: producer -> STAGES stages -> consumer.
+ *
+ * The producer sends MESSAGES messages stamped with their send time; every stage receives from the channel before
+ * it and sends to the one after it, and the consumer records each message's end-to-end latency. The run is
+ * repeated for several channel capacities, from unbuffered (every hop is a direct hand-off between two parked
+ * threads) to well buffered (threads run in batches). Optional background threads keep the run queue busy by
+ * yielding in a loop: a woken pipeline thread that had to queue behind them would wait for all of them.
+ *
+ * Usage: bench_pipeline [stages] [background]   (default: 4 stages, no background threads)
+ * Output is CSV: stages,background,capacity,msgs_per_s,lat_mean_us,lat_p50_us,lat_p99_us
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "bench.h"
+#include "uthreads.h"
+
+#define MESSAGES 200000
+#define MAX_STAGES 64
+#define BENCH_QUANTUM 10000 /* 10ms */
+
+struct Message {
+    uint64_t sent;
+    long seq; /* -1 ends the run */
+};
+
+static const int capacities[] = {0, 1, 16, 256};
+
+static int stages = 4;
+static int background = 0;
+static uthread_chan_t *channels[MAX_STAGES + 1];
+static int next_stage;
+static uint64_t latencies[MESSAGES];
+static int finished;
+
+static void yielder(void)
+{
+    while (true) {
+        uthread_yield();
+    }
+}
+
+static void producer(void)
+{
+    Message message;
+    for (long seq = 0; seq <= MESSAGES; seq++) {
+        message.seq = seq < MESSAGES ? seq : -1;
+        message.sent = now_ns();
+        uthread_chan_send(channels[0], &message);
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+static void stage(void)
+{
+    int index = next_stage++;
+    Message message;
+    do {
+        uthread_chan_recv(channels[index], &message);
+        uthread_chan_send(channels[index + 1], &message);
+    } while (message.seq >= 0);
+    uthread_terminate(uthread_get_tid());
+}
+
+static void consumer(void)
+{
+    Message message;
+    while (true) {
+        uthread_chan_recv(channels[stages], &message);
+        if (message.seq < 0) {
+            break;
+        }
+        latencies[message.seq] = now_ns() - message.sent;
+    }
+    finished = 1;
+    uthread_wake(&finished, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1) {
+        stages = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        background = atoi(argv[2]);
+    }
+    if (stages < 0 || stages > MAX_STAGES) {
+        fprintf(stderr, "stages must be in [0, %d]\n", MAX_STAGES);
+        return 1;
+    }
+    if (uthread_init(BENCH_QUANTUM, MAX_THREAD_NUM + background) < 0) {
+        return 1;
+    }
+    for (int i = 0; i < background; i++) {
+        uthread_spawn(yielder);
+    }
+    printf("stages,background,capacity,msgs_per_s,lat_mean_us,lat_p50_us,lat_p99_us\n");
+    for (size_t c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++) {
+        for (int i = 0; i <= stages; i++) {
+            channels[i] = uthread_chan_create(sizeof(Message), capacities[c]);
+        }
+        next_stage = 0;
+        finished = 0;
+        uthread_spawn(consumer);
+        for (int i = 0; i < stages; i++) {
+            uthread_spawn(stage);
+        }
+        uint64_t start = now_ns();
+        uthread_spawn(producer);
+        // the main thread waits parked, so it does not take turns with the pipeline
+        while (!finished) {
+            uthread_wait(&finished, 0);
+        }
+        double seconds = (now_ns() - start) / 1e9;
+        double total = 0;
+        for (int i = 0; i < MESSAGES; i++) {
+            total += latencies[i];
+        }
+        std::sort(latencies, latencies + MESSAGES);
+        printf("%d,%d,%d,%.0f,%.2f,%.2f,%.2f\n", stages, background, capacities[c], MESSAGES / seconds,
+               total / MESSAGES / 1e3, latencies[MESSAGES / 2] / 1e3, latencies[(int) (MESSAGES * 0.99)] / 1e3);
+        uthread_yield(); // let the threads that already ended terminate before the channels go
+        for (int i = 0; i <= stages; i++) {
+            uthread_chan_destroy(channels[i]);
+        }
+    }
+    uthread_terminate(0);
+    return 0;
+}
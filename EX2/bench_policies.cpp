@@ -0,0 +1,133 @@
+/*
+ * bench_policies.cpp - one mixed workload, built against the library once per scheduling policy.
+ *
+ * BATCH threads burn CPU in chunks of BATCH_WORK steps for as long as the run lasts; INTERACTIVE threads wait for
+ * requests and answer each with a short burst of REQUEST_WORK steps. A dispatcher sleeps SLEEP_QUANTUMS quantums,
+ * stamps a request for every interactive thread and wakes them (uthread_wake, so the woken threads are queued by
+ * the policy), then waits until all of them answered; it does that ROUNDS times. A request's response time runs
+ * from its stamp to the end of its burst. Batch throughput and the spread between the least and the most served
+ * batch thread (min/max of their chunks) show what the policy costs the batch threads.
+ *
+ * make bench-policies runs every bench_policies_<policy> binary, see POLICIES in the Makefile.
+ * Output is CSV: policy,batch,interactive,batch_chunks_per_s,batch_min_max,resp_p50_us,resp_p99_us
+ */
+
+#include <stdio.h>
+#include <algorithm>
+#include "bench.h"
+#include "uthreads.h"
+
+#ifndef BENCH_POLICY
+#define BENCH_POLICY "default"
+#endif
+
+#define BATCH 8
+#define INTERACTIVE 4
+#define ROUNDS 100
+#define SLEEP_QUANTUMS 2
+#define BATCH_WORK 20000
+#define REQUEST_WORK 20000
+#define BENCH_QUANTUM 1000
+
+static int pending[INTERACTIVE];
+static uint64_t stamps[INTERACTIVE];
+static uint64_t responses[INTERACTIVE * ROUNDS];
+static int answered[INTERACTIVE];
+static int served;
+static volatile long chunks[BATCH];
+static volatile bool stop;
+static int finished;
+static int next_batch;
+static int next_interactive;
+static volatile unsigned long sink;
+
+static unsigned long work(unsigned long x, int steps)
+{
+    for (int i = 0; i < steps; i++) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+    }
+    return x;
+}
+
+static void batch(void)
+{
+    int index = next_batch++;
+    unsigned long x = index;
+    while (!stop) {
+        x = work(x, BATCH_WORK);
+        chunks[index]++;
+    }
+    sink = x;
+    uthread_terminate(uthread_get_tid());
+}
+
+static void interactive(void)
+{
+    int index = next_interactive++;
+    while (answered[index] < ROUNDS) {
+        while (!pending[index]) {
+            uthread_wait(&pending[index], 0);
+        }
+        sink = work(index, REQUEST_WORK);
+        responses[index * ROUNDS + answered[index]++] = now_ns() - stamps[index];
+        pending[index] = 0;
+        served++;
+        uthread_wake(&served, 1);
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+static void dispatcher(void)
+{
+    for (int round = 0; round < ROUNDS; round++) {
+        uthread_sleep(SLEEP_QUANTUMS);
+        served = 0;
+        for (int i = 0; i < INTERACTIVE; i++) {
+            stamps[i] = now_ns();
+            pending[i] = 1;
+            uthread_wake(&pending[i], 1);
+        }
+        while (served < INTERACTIVE) {
+            uthread_wait(&served, served);
+        }
+    }
+    stop = true;
+    finished = 1;
+    uthread_wake(&finished, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+int main(void)
+{
+    if (uthread_init(BENCH_QUANTUM, 1 + BATCH + INTERACTIVE + 1) < 0) {
+        return 1;
+    }
+    for (int i = 0; i < INTERACTIVE; i++) {
+        uthread_spawn(interactive);
+    }
+    for (int i = 0; i < BATCH; i++) {
+        uthread_spawn(batch);
+    }
+    uint64_t start = now_ns();
+    uthread_spawn(dispatcher);
+    // the main thread waits parked, out of the run queue
+    while (!finished) {
+        uthread_wait(&finished, 0);
+    }
+    double seconds = (now_ns() - start) / 1e9;
+    long total = 0;
+    long fewest = chunks[0];
+    long most = chunks[0];
+    for (int i = 0; i < BATCH; i++) {
+        total += chunks[i];
+        fewest = std::min(fewest, (long) chunks[i]);
+        most = std::max(most, (long) chunks[i]);
+    }
+    const int count = INTERACTIVE * ROUNDS;
+    std::sort(responses, responses + count);
+    printf("policy,batch,interactive,batch_chunks_per_s,batch_min_max,resp_p50_us,resp_p99_us\n");
+    printf("%s,%d,%d,%.0f,%.2f,%.1f,%.1f\n", BENCH_POLICY, BATCH, INTERACTIVE, total / seconds,
+           most > 0 ? (double) fewest / most : 0.0, responses[count / 2] / 1e3, responses[(int) (count * 0.99)] / 1e3);
+    uthread_terminate(0);
+    return 0;
+}
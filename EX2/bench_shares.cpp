@@ -0,0 +1,79 @@
+/*
+ * bench_shares.cpp - CPU shares of always-READY threads with different weights (uthread_set_weight).
+ *
+ * THREADS threads burn CPU for SLEEP_QUANTUMS quantums, timed by a thread that sleeps; thread i has weight
+ * (i + 1) * UTHREAD_DEFAULT_WEIGHT. Their shares are measured with uthread_get_runtime and compared with the
+ * share their weight entitles them to, weight / sum of weights. Under the CFS policy the error should be a few
+ * percent at most; the other policies ignore weights and give every thread the same share.
+ *
+ * Built once per policy like bench_policies (make bench-shares).
+ * Output is CSV: policy,tid,weight,expected_share,share,error_pct
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "uthreads.h"
+
+#ifndef BENCH_POLICY
+#define BENCH_POLICY "default"
+#endif
+
+#define THREADS 4
+#define SLEEP_QUANTUMS 250
+#define BENCH_QUANTUM 1000
+
+static volatile unsigned long sink;
+static int finished;
+
+static void burner(void)
+{
+    unsigned long x = uthread_get_tid();
+    while (true) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+        sink = x;
+    }
+}
+
+static void timer(void)
+{
+    uthread_sleep(SLEEP_QUANTUMS);
+    finished = 1;
+    uthread_wake(&finished, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+int main(void)
+{
+    if (uthread_init(BENCH_QUANTUM, 1 + THREADS + 1) < 0) {
+        return 1;
+    }
+    int tids[THREADS];
+    int weights[THREADS];
+    long total_weight = 0;
+    for (int i = 0; i < THREADS; i++) {
+        tids[i] = uthread_spawn(burner);
+        weights[i] = (i + 1) * UTHREAD_DEFAULT_WEIGHT;
+        uthread_set_weight(tids[i], weights[i]);
+        total_weight += weights[i];
+    }
+    uthread_spawn(timer);
+    // the main thread waits parked, so only the burners compete for the CPU
+    while (!finished) {
+        uthread_wait(&finished, 0);
+    }
+    long runtimes[THREADS];
+    long total_runtime = 0;
+    for (int i = 0; i < THREADS; i++) {
+        runtimes[i] = uthread_get_runtime(tids[i]);
+        total_runtime += runtimes[i];
+    }
+    printf("policy,tid,weight,expected_share,share,error_pct\n");
+    for (int i = 0; i < THREADS; i++) {
+        double expected = (double) weights[i] / total_weight;
+        double share = (double) runtimes[i] / total_runtime;
+        printf("%s,%d,%d,%.3f,%.3f,%.1f\n", BENCH_POLICY, tids[i], weights[i], expected, share,
+               100.0 * fabs(share - expected) / expected);
+    }
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * bench_sleep_jitter.cpp - how far from the requested time sleeping threads wake up.
+ *
+ * SLEEPERS threads each sleep ROUNDS times for a random MIN_US to MAX_US microseconds, and measure the error: the
+ * time they run again (CLOCK_MONOTONIC) minus the time they asked to wake up.
+ * - uthread_sleep_until: the wall-clock sleep, to an absolute deadline;
+ * - uthread_sleep:       the same time converted to quantums (rounded), as the only way to sleep before.
+ * Each runs on an otherwise idle process, and next to BACKGROUND threads that burn the CPU; a woken thread then
+ * also waits for its turn behind them (FIFO: up to one quantum each).
+ *
+ * Output is CSV: api,background,wakeups,mean_err_us,p50_abs_err_us,p99_abs_err_us,max_abs_err_us
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include "bench.h"
+#include "uthreads.h"
+
+#define SLEEPERS 8
+#define BACKGROUND 2
+#define ROUNDS 100
+#define MIN_US 500
+#define MAX_US 5000
+#define BENCH_QUANTUM 1000
+
+static bool wall_clock;
+static int next_sleeper;
+static int done;
+static int64_t errors[SLEEPERS * ROUNDS];
+static volatile unsigned long sink;
+
+static void background(void)
+{
+    unsigned long x = uthread_get_tid();
+    while (true) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+        sink = x;
+    }
+}
+
+static void sleeper(void)
+{
+    int index = next_sleeper++;
+    unsigned long x = 0x9e3779b97f4a7c15UL * (index + 1);
+    for (int i = 0; i < ROUNDS; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        long usec = MIN_US + (long) (x % (MAX_US - MIN_US));
+        uint64_t deadline = now_ns() + usec * 1000;
+        if (wall_clock) {
+            struct timespec t = {(time_t) (deadline / 1000000000), (long) (deadline % 1000000000)};
+            uthread_sleep_until(&t);
+        } else {
+            uthread_sleep((int) ((usec + BENCH_QUANTUM / 2) / BENCH_QUANTUM));
+        }
+        errors[index * ROUNDS + i] = (int64_t) (now_ns() - deadline);
+    }
+    done++;
+    uthread_wake(&done, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+static void run(bool wall, int background_count)
+{
+    wall_clock = wall;
+    next_sleeper = 0;
+    done = 0;
+    int background_tids[BACKGROUND];
+    for (int i = 0; i < background_count; i++) {
+        background_tids[i] = uthread_spawn(background);
+    }
+    for (int i = 0; i < SLEEPERS; i++) {
+        uthread_spawn(sleeper);
+    }
+    // the main thread waits parked, out of the run queue
+    while (done < SLEEPERS) {
+        uthread_wait(&done, done);
+    }
+    for (int i = 0; i < background_count; i++) {
+        uthread_terminate(background_tids[i]);
+    }
+    const int wakeups = SLEEPERS * ROUNDS;
+    double sum = 0;
+    for (int i = 0; i < wakeups; i++) {
+        sum += errors[i];
+        errors[i] = llabs(errors[i]);
+    }
+    std::sort(errors, errors + wakeups);
+    printf("%s,%d,%d,%.1f,%.1f,%.1f,%.1f\n", wall ? "uthread_sleep_until" : "uthread_sleep", background_count,
+           wakeups, sum / wakeups / 1e3, errors[wakeups / 2] / 1e3, errors[(int) (wakeups * 0.99)] / 1e3,
+           errors[wakeups - 1] / 1e3);
+}
+
+int main(void)
+{
+    if (uthread_init(BENCH_QUANTUM, 1 + SLEEPERS + BACKGROUND) < 0) {
+        return 1;
+    }
+    printf("api,background,wakeups,mean_err_us,p50_abs_err_us,p99_abs_err_us,max_abs_err_us\n");
+    for (int background_count : {0, BACKGROUND}) {
+        run(true, background_count);
+        run(false, background_count);
+    }
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * bench_sleep_tick.cpp - cost of one scheduler tick as a function of the number of sleeping threads.
+ *
+ * Part 1 spawns up to MAX_THREAD_NUM-1 threads that go to sleep for a very long time, then measures a
+ * SIGVTALRM tick on the main thread (signal delivery + quantum_update_func) with nothing ready to run.
+ * Part 2 compares the SleepQueue with the previous full-table sweep for sleeper counts beyond the library cap.
+ *
+ * Output is CSV: which,sleepers,ns_per_tick
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include <vector>
+#include "bench.h"
+#include "SleepQueue.h"
+#include "uthreads.h"
+
+#define TICKS 20000
+#define LONG_SLEEP 1000000000
+#define BENCH_QUANTUM 100000000 /* long enough that the timer never fires by itself */
+
+static const int sleeper_counts[] = {0, 10, 50, MAX_THREAD_NUM - 1};
+static const int table_sizes[] = {100, 1000, 10000, 100000};
+
+static void sleeper_entry(void)
+{
+    uthread_sleep(LONG_SLEEP);
+}
+
+static double library_tick(int sleepers)
+{
+    static int spawned = 0;
+    for (; spawned < sleepers; spawned++) {
+        uthread_spawn(sleeper_entry);
+    }
+    // one switch lets every new thread run and fall asleep, then control is back here
+    kill(getpid(), SIGVTALRM);
+    uint64_t start = now_ns();
+    for (int i = 0; i < TICKS; i++) {
+        kill(getpid(), SIGVTALRM);
+    }
+    return (double) (now_ns() - start) / TICKS;
+}
+
+/**
+ * Tick of the heap with sleepers far in the future (nobody expires).
+ */
+static double heap_tick(int sleepers)
+{
+    std::vector<Thread *> threads;
+    SleepQueue queue(sleepers);
+    for (int i = 0; i < sleepers; i++) {
+        threads.push_back(new Thread());
+        queue.push(threads.back(), LONG_SLEEP + i);
+    }
+    volatile int woken = 0;
+    uint64_t start = now_ns();
+    for (int now = 0; now < TICKS; now++) {
+        while (queue.pop_expired(now) != nullptr) {
+            woken++;
+        }
+    }
+    double result = (double) (now_ns() - start) / TICKS;
+    for (size_t i = 0; i < threads.size(); i++) {
+        delete threads[i];
+    }
+    return result;
+}
+
+/**
+ * Tick of the previous implementation: decrement every slot of a table of the given size.
+ */
+static double sweep_tick(int table_size)
+{
+    std::vector<int> sleeping(table_size, LONG_SLEEP);
+    volatile int woken = 0;
+    uint64_t start = now_ns();
+    for (int tick = 0; tick < TICKS; tick++) {
+        for (int i = 0; i < table_size; i++) {
+            if (sleeping[i] > 0) {
+                sleeping[i]--;
+            }
+            if (sleeping[i] == 0) {
+                woken++;
+            }
+        }
+    }
+    return (double) (now_ns() - start) / TICKS;
+}
+
+int main(void)
+{
+    printf("which,sleepers,ns_per_tick\n");
+    for (size_t i = 0; i < sizeof(table_sizes) / sizeof(table_sizes[0]); i++) {
+        printf("heap,%d,%.2f\n", table_sizes[i], heap_tick(table_sizes[i]));
+        printf("sweep,%d,%.2f\n", table_sizes[i], sweep_tick(table_sizes[i]));
+    }
+
+    uthread_init(BENCH_QUANTUM);
+    for (size_t i = 0; i < sizeof(sleeper_counts) / sizeof(sleeper_counts[0]); i++) {
+        printf("sigvtalrm_tick,%d,%.2f\n", sleeper_counts[i], library_tick(sleeper_counts[i]));
+    }
+    uthread_terminate(0);
+    return 0;
+}
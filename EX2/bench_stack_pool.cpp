@@ -0,0 +1,128 @@
+/*
+ * bench_stack_pool.cpp - thread stack allocation: StackPool vs. the previous new char[STACK_SIZE].
+ *
+ * For each allocator, keeps LIVE stacks allocated and churns pseudo-random ones through free + allocate,
+ * touching the top of every new stack like a starting thread does. Reports ns per churn operation and the
+ * process RSS afterwards (each allocator runs in its own child process). Finally reports uthread_spawn +
+ * uthread_terminate throughput through the library.
+ *
+ * Output is CSV: which,live_stacks,ns_per_op,rss_kb
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <vector>
+#include "bench.h"
+#include "StackPool.h"
+#include "uthreads.h"
+
+#define CHURN_OPS 1000000
+#define LIB_CHURN_OPS 200000
+#define BENCH_QUANTUM 100000000 /* long enough that no preemption happens while measuring */
+
+static const int live_counts[] = {10, 1000, 10000};
+
+static long rss_kb()
+{
+    long pages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        if (fscanf(statm, "%*s %ld", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(statm);
+    }
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void touch(char *stack)
+{
+    ((volatile char *) stack)[STACK_SIZE - 1] = 1;
+}
+
+static void heap_churn(int live)
+{
+    std::vector<char *> stacks;
+    for (int i = 0; i < live; i++) {
+        stacks.push_back(new char[STACK_SIZE]);
+        touch(stacks.back());
+    }
+    uint64_t rnd = 12345;
+    uint64_t start = now_ns();
+    for (int i = 0; i < CHURN_OPS; i++) {
+        rnd = rnd * 6364136223846793005ULL + 1442695040888963407ULL;
+        char *&slot = stacks[(rnd >> 33) % live];
+        delete[] slot;
+        slot = new char[STACK_SIZE];
+        touch(slot);
+    }
+    printf("new_delete,%d,%.2f,%ld\n", live, (double) (now_ns() - start) / CHURN_OPS, rss_kb());
+}
+
+static void pool_churn(int live, bool huge_pages)
+{
+    StackPool pool(STACK_SIZE, huge_pages);
+    std::vector<char *> stacks;
+    for (int i = 0; i < live; i++) {
+        stacks.push_back(pool.acquire());
+        touch(stacks.back());
+    }
+    uint64_t rnd = 12345;
+    uint64_t start = now_ns();
+    for (int i = 0; i < CHURN_OPS; i++) {
+        rnd = rnd * 6364136223846793005ULL + 1442695040888963407ULL;
+        char *&slot = stacks[(rnd >> 33) % live];
+        pool.release(slot);
+        slot = pool.acquire();
+        touch(slot);
+    }
+    printf("%s,%d,%.2f,%ld\n", huge_pages ? "stack_pool_huge" : "stack_pool", live,
+           (double) (now_ns() - start) / CHURN_OPS, rss_kb());
+}
+
+/**
+ * Runs one measurement in a child process so RSS numbers do not mix.
+ */
+static void isolated(void (*churn)(int, bool), int live, bool huge_pages)
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        churn(live, huge_pages);
+        fflush(stdout);
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+static void heap_churn_adapter(int live, bool)
+{
+    heap_churn(live);
+}
+
+static void idle_entry(void)
+{
+    while (1) {
+    }
+}
+
+int main(void)
+{
+    printf("which,live_stacks,ns_per_op,rss_kb\n");
+    for (size_t i = 0; i < sizeof(live_counts) / sizeof(live_counts[0]); i++) {
+        isolated(heap_churn_adapter, live_counts[i], false);
+        isolated(pool_churn, live_counts[i], false);
+        isolated(pool_churn, live_counts[i], true);
+    }
+
+    uthread_init(BENCH_QUANTUM);
+    uint64_t start = now_ns();
+    for (int i = 0; i < LIB_CHURN_OPS; i++) {
+        uthread_terminate(uthread_spawn(idle_entry));
+    }
+    printf("uthread_spawn+terminate,1,%.2f,%ld\n", (double) (now_ns() - start) / LIB_CHURN_OPS, rss_kb());
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * bench_steal.cpp - work stealing on an imbalanced fork-join workload, on 1..N worker kernel threads.
+ *
+ * The main thread forks TASKS uthreads at once and joins them by yielding until all are done. Every HEAVY_EVERY-th
+ * task does HEAVY_FACTOR times the work of the others, and all of them are queued on the main thread's worker:
+ * the other workers only get work by stealing it. Every worker count runs in a forked child (uthread_init can only
+ * be called once per process), which reports back through a pipe:
+ * - the makespan (fork to last join) and the number of steals, also per second;
+ * - the tail of the start latency (fork to the task's first instruction) and of the finish latency (fork to the
+ *   task's end), in micro-seconds.
+ *
+ * Usage: bench_steal [max_workers]   (default: the number of online CPUs)
+ * Output is CSV: workers,ms,steals,steals_per_s,start_p50_us,start_p99_us,finish_p50_us,finish_p99_us,finish_max_us
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <atomic>
+#include "bench.h"
+#include "uthreads.h"
+
+#define TASKS 256
+#define HEAVY_EVERY 8
+#define HEAVY_FACTOR 16
+#define WORK_ITERATIONS 1000000UL
+#define BENCH_QUANTUM 1000
+
+struct Result {
+    uint64_t makespan;
+    long steals;
+    uint64_t start_p50, start_p99;
+    uint64_t finish_p50, finish_p99, finish_max;
+};
+
+static std::atomic<int> done(0);
+static uint64_t fork_time;
+static uint64_t start_times[TASKS + 1];
+static uint64_t finish_times[TASKS + 1];
+static volatile unsigned long results[TASKS + 1];
+
+static void task(void)
+{
+    int tid = uthread_get_tid();
+    start_times[tid] = now_ns();
+    unsigned long iterations = (tid % HEAVY_EVERY == 0) ? WORK_ITERATIONS * HEAVY_FACTOR : WORK_ITERATIONS;
+    unsigned long x = (unsigned long) tid;
+    for (unsigned long i = 0; i < iterations; i++) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+    }
+    results[tid] = x;
+    finish_times[tid] = now_ns();
+    done.fetch_add(1);
+    uthread_terminate(tid);
+}
+
+/**
+ * @return - the given percentile of the latencies since fork_time in times[1..TASKS].
+ */
+static uint64_t percentile(const uint64_t *times, double p)
+{
+    uint64_t latencies[TASKS];
+    for (int i = 0; i < TASKS; i++) {
+        latencies[i] = times[i + 1] - fork_time;
+    }
+    std::sort(latencies, latencies + TASKS);
+    int index = (int) (p * (TASKS - 1) + 0.5);
+    return latencies[index];
+}
+
+/**
+ * Runs the workload on the given number of workers, in this (child) process.
+ * @return - false on failure.
+ */
+static bool run(int workers, Result *result)
+{
+    if (uthread_init(BENCH_QUANTUM, TASKS + 1, workers) < 0) {
+        return false;
+    }
+    fork_time = now_ns();
+    for (int i = 0; i < TASKS; i++) {
+        if (uthread_spawn(task) < 0) {
+            return false;
+        }
+    }
+    while (done.load() < TASKS) {
+        uthread_yield();
+    }
+    result->makespan = now_ns() - fork_time;
+    result->steals = uthread_get_steals();
+    result->start_p50 = percentile(start_times, 0.50);
+    result->start_p99 = percentile(start_times, 0.99);
+    result->finish_p50 = percentile(finish_times, 0.50);
+    result->finish_p99 = percentile(finish_times, 0.99);
+    result->finish_max = percentile(finish_times, 1.0);
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int max_workers = argc > 1 ? atoi(argv[1]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_workers < 1) {
+        max_workers = 1;
+    }
+    printf("workers,ms,steals,steals_per_s,start_p50_us,start_p99_us,finish_p50_us,finish_p99_us,finish_max_us\n");
+    for (int workers = 1; workers <= max_workers; workers++) {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            return 1;
+        }
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            Result result = {};
+            if (!run(workers, &result) || write(fds[1], &result, sizeof(result)) != sizeof(result)) {
+                _exit(1);
+            }
+            uthread_terminate(0);
+        }
+        close(fds[1]);
+        Result result;
+        if (read(fds[0], &result, sizeof(result)) != sizeof(result)) {
+            return 1;
+        }
+        close(fds[0]);
+        waitpid(pid, NULL, 0);
+        double seconds = result.makespan / 1e9;
+        printf("%d,%.1f,%ld,%.0f,%.0f,%.0f,%.0f,%.0f,%.0f\n", workers, seconds * 1e3, result.steals,
+               result.steals / seconds, result.start_p50 / 1e3, result.start_p99 / 1e3, result.finish_p50 / 1e3,
+               result.finish_p99 / 1e3, result.finish_max / 1e3);
+    }
+    return 0;
+}
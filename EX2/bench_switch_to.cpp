@@ -0,0 +1,94 @@
+/*
+ * bench_switch_to.cpp - two-thread ping-pong: uthread_switch_to vs. uthread_resume + uthread_yield.
+ *
+ * Two threads pass the CPU back and forth ROUND_TRIPS times; on its turn each one resumes its peer and hands it
+ * the CPU, either with uthread_yield (the peer runs when it reaches the head of the READY queue) or with
+ * uthread_switch_to (the peer runs at once). BACKGROUND threads that only yield share the READY queue: with
+ * uthread_yield every hop waits for all of them, with uthread_switch_to they only run when the timer preempts
+ * the pair. Round trips are two hops.
+ *
+ * Output is CSV: mode,background,round_trip_ns
+ */
+
+#include <stdio.h>
+#include "bench.h"
+#include "uthreads.h"
+
+#define ROUND_TRIPS 100000
+#define MAX_BACKGROUND 64
+#define BENCH_QUANTUM 10000 /* 10ms */
+
+enum Mode { RESUME_YIELD, SWITCH_TO, MODES };
+
+static const char *mode_names[MODES] = {"resume_yield", "switch_to"};
+static const int backgrounds[] = {0, 1, 4, 16, 64};
+
+static Mode mode;
+static int pinger_tid;
+static int ponger_tid;
+static int done;
+
+static void hand_over(int peer)
+{
+    uthread_resume(peer);
+    if (mode == SWITCH_TO) {
+        uthread_switch_to(peer);
+    } else {
+        uthread_yield();
+    }
+}
+
+static void yielder(void)
+{
+    while (true) {
+        uthread_yield();
+    }
+}
+
+static void pinger(void)
+{
+    for (int i = 0; i < ROUND_TRIPS; i++) {
+        hand_over(ponger_tid);
+    }
+    done = 1;
+    uthread_wake(&done, 1);
+    uthread_terminate(ponger_tid);
+    uthread_terminate(uthread_get_tid());
+}
+
+static void ponger(void)
+{
+    while (true) {
+        hand_over(pinger_tid);
+    }
+}
+
+int main(void)
+{
+    if (uthread_init(BENCH_QUANTUM, 1 + 2 + MAX_BACKGROUND) < 0) {
+        return 1;
+    }
+    printf("mode,background,round_trip_ns\n");
+    int spawned = 0;
+    for (size_t b = 0; b < sizeof(backgrounds) / sizeof(backgrounds[0]); b++) {
+        while (spawned < backgrounds[b]) {
+            uthread_spawn(yielder);
+            spawned++;
+        }
+        for (int m = 0; m < MODES; m++) {
+            mode = (Mode) m;
+            done = 0;
+            ponger_tid = uthread_spawn(ponger);
+            pinger_tid = uthread_spawn(pinger);
+            uint64_t start = now_ns();
+            // the main thread waits parked, out of the READY queue
+            while (!done) {
+                uthread_wait(&done, 0);
+            }
+            uint64_t elapsed = now_ns() - start;
+            printf("%s,%d,%.1f\n", mode_names[m], spawned, (double) elapsed / ROUND_TRIPS);
+        }
+    }
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,73 @@
+/*
+ * bench_thread_scaling.cpp - scheduler overhead per quantum with 1k, 10k and 100k live uthreads.
+ *
+ * All threads are READY and switch on every SIGVTALRM they raise themselves, so each measured quantum is one
+ * tick: signal delivery, quantum_update_func and a context switch. The per-quantum cost should not depend on
+ * the number of threads. Also reports the spawn cost and the RSS once all threads exist.
+ *
+ * Output is CSV: threads,spawn_ns_per_thread,ns_per_quantum,rss_kb
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include "bench.h"
+#include "uthreads.h"
+
+#define MIN_QUANTUMS 200000
+#define BENCH_QUANTUM 100000000 /* long enough that the timer never fires by itself */
+
+static const int thread_counts[] = {1000, 10000, 100000};
+
+static long rss_kb()
+{
+    long pages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        if (fscanf(statm, "%*s %ld", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(statm);
+    }
+    return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void spinner(void)
+{
+    while (1) {
+        kill(getpid(), SIGVTALRM);
+    }
+}
+
+int main(void)
+{
+    int count = sizeof(thread_counts) / sizeof(thread_counts[0]);
+    if (uthread_init(BENCH_QUANTUM, thread_counts[count - 1] + 1) < 0) {
+        return 1;
+    }
+    printf("threads,spawn_ns_per_thread,ns_per_quantum,rss_kb\n");
+    int live = 0;
+    for (int i = 0; i < count; i++) {
+        uint64_t start = now_ns();
+        for (; live < thread_counts[i]; live++) {
+            if (uthread_spawn(spinner) < 0) {
+                return 1;
+            }
+        }
+        double spawn_ns = (double) (now_ns() - start) / thread_counts[i];
+
+        // every thread runs once so its stack and control block are warm, then measure whole rounds
+        kill(getpid(), SIGVTALRM);
+        int rounds = MIN_QUANTUMS / (live + 1) + 1;
+        int first = uthread_get_total_quantums();
+        start = now_ns();
+        for (int round = 0; round < rounds; round++) {
+            kill(getpid(), SIGVTALRM);
+        }
+        double per_quantum = (double) (now_ns() - start) / (uthread_get_total_quantums() - first);
+        printf("%d,%.2f,%.2f,%ld\n", live, spawn_ns, per_quantum, rss_kb());
+    }
+    uthread_terminate(0);
+    return 0;
+}
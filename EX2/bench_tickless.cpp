@@ -0,0 +1,100 @@
+/*
+ * bench_tickless.cpp - cost of the quantum timer while one thread has the CPU to itself.
+ *
+ * The same CPU-bound loop runs
+ * - bare:   before uthread_init, with no timer at all;
+ * - alone:  in the main thread, the only thread there is;
+ * - shared: in two threads taking turns (WORK / 2 each), where the timer has to tick.
+ * overhead_pct is the time over bare. quantums is how much uthread_get_total_quantums advanced, to be compared
+ * with expected_quantums, the CPU time of the run over the quantum: a tickless worker counts them lazily. A timer
+ * on a CPU clock only fires at the kernel's own ticks, so with quantums shorter than those, ticking builds count
+ * fewer. "make bench" builds this file twice: bench_tickless with the tickless timer and bench_tickless_periodic
+ * with -DUTHREADS_PERIODIC_TICK, where SIGVTALRM comes every quantum regardless.
+ *
+ * Usage: bench_tickless [quantum_usecs]   (default: 1000)
+ * Output is CSV: build,case,quantum_us,work_ms,overhead_pct,quantums,expected_quantums
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "bench.h"
+#include "uthreads.h"
+
+#define WORK 400000000UL
+#define BENCH_QUANTUM 1000
+
+#ifdef UTHREADS_PERIODIC_TICK
+#define BUILD "periodic"
+#else
+#define BUILD "tickless"
+#endif
+
+static int quantum_us;
+static int done;
+static volatile unsigned long sink;
+
+static void work(unsigned long iterations)
+{
+    unsigned long x = 1;
+    for (unsigned long i = 0; i < iterations; i++) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+    }
+    sink = x;
+}
+
+static uint64_t cpu_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return nanosectime(t);
+}
+
+static void half(void)
+{
+    work(WORK / 2);
+    done++;
+    uthread_wake(&done, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+static void report(const char *name, uint64_t ns, uint64_t bare_ns, int quantums, uint64_t cpu)
+{
+    printf("%s,%s,%d,%.1f,%.2f,%d,%lu\n", BUILD, name, quantum_us, ns / 1e6,
+           bare_ns != 0 ? (ns - (double) bare_ns) * 100 / bare_ns : 0, quantums,
+           (unsigned long) (cpu / (quantum_us * 1000UL)));
+}
+
+int main(int argc, char *argv[])
+{
+    quantum_us = argc > 1 ? atoi(argv[1]) : BENCH_QUANTUM;
+    printf("build,case,quantum_us,work_ms,overhead_pct,quantums,expected_quantums\n");
+    uint64_t start = now_ns();
+    work(WORK);
+    uint64_t bare = now_ns() - start;
+    report("bare", bare, 0, 0, 0);
+
+    if (uthread_init(quantum_us, 3) < 0) {
+        return 1;
+    }
+    int quantums = uthread_get_total_quantums();
+    uint64_t cpu = cpu_ns();
+    start = now_ns();
+    work(WORK);
+    uint64_t ns = now_ns() - start;
+    report("alone", ns, bare, uthread_get_total_quantums() - quantums, cpu_ns() - cpu);
+
+    quantums = uthread_get_total_quantums();
+    cpu = cpu_ns();
+    start = now_ns();
+    uthread_spawn(half);
+    uthread_spawn(half);
+    // the main thread waits parked, out of the run queue
+    while (done < 2) {
+        uthread_wait(&done, done);
+    }
+    ns = now_ns() - start;
+    report("shared", ns, bare, uthread_get_total_quantums() - quantums, cpu_ns() - cpu);
+    uthread_terminate(0);
+    return 0;
+}
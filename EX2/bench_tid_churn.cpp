@@ -0,0 +1,106 @@
+/*
+ * bench_tid_churn.cpp - spawn/terminate churn with a growing number of live threads.
+ *
+ * Part 1 drives the TidBitmap directly and compares it with the old linear scan for the smallest free ID.
+ * Part 2 measures uthread_spawn + uthread_terminate through the library while 10..100k threads stay alive.
+ *
+ * Output is CSV: which,live_threads,ns_per_op
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "bench.h"
+#include "TidBitmap.h"
+#include "uthreads.h"
+
+#define CHURN_OPS 200000
+#define LIB_CHURN_OPS 20000
+#define BENCH_QUANTUM 100000000 /* long enough that no preemption happens while measuring */
+
+static const int live_counts[] = {10, 100, 1000, 10000, 100000};
+
+/**
+ * Releases a pseudo-random live ID and takes the smallest free one again, CHURN_OPS times.
+ */
+static double bitmap_churn(int live)
+{
+    TidBitmap tids(live + 1);
+    for (int i = 0; i < live; i++) {
+        tids.acquire();
+    }
+    uint64_t rnd = 12345;
+    uint64_t start = now_ns();
+    for (int i = 0; i < CHURN_OPS; i++) {
+        rnd = rnd * 6364136223846793005ULL + 1442695040888963407ULL;
+        tids.release((int) ((rnd >> 33) % live));
+        tids.acquire();
+    }
+    return (double) (now_ns() - start) / CHURN_OPS;
+}
+
+/**
+ * Same churn with the previous find_minimal_tid() linear scan.
+ */
+static double linear_churn(int live)
+{
+    std::vector<char> used(live + 1, 0);
+    for (int i = 0; i < live; i++) {
+        used[i] = 1;
+    }
+    uint64_t rnd = 12345;
+    uint64_t start = now_ns();
+    for (int i = 0; i < CHURN_OPS; i++) {
+        rnd = rnd * 6364136223846793005ULL + 1442695040888963407ULL;
+        used[(rnd >> 33) % live] = 0;
+        for (int id = 0; id <= live; id++) {
+            if (!used[id]) {
+                used[id] = 1;
+                break;
+            }
+        }
+    }
+    return (double) (now_ns() - start) / CHURN_OPS;
+}
+
+static void idle_entry(void)
+{
+    while (1) {
+    }
+}
+
+/**
+ * Keeps live - 1 spawned threads alive and churns one more through spawn/terminate.
+ */
+static double library_churn(int live)
+{
+    std::vector<int> tids;
+    for (int i = 1; i < live; i++) {
+        tids.push_back(uthread_spawn(idle_entry));
+    }
+    uint64_t start = now_ns();
+    for (int i = 0; i < LIB_CHURN_OPS; i++) {
+        uthread_terminate(uthread_spawn(idle_entry));
+    }
+    double result = (double) (now_ns() - start) / LIB_CHURN_OPS;
+    for (size_t i = 0; i < tids.size(); i++) {
+        uthread_terminate(tids[i]);
+    }
+    return result;
+}
+
+int main(void)
+{
+    printf("which,live_threads,ns_per_op\n");
+    for (size_t i = 0; i < sizeof(live_counts) / sizeof(live_counts[0]); i++) {
+        printf("bitmap,%d,%.2f\n", live_counts[i], bitmap_churn(live_counts[i]));
+        printf("linear,%d,%.2f\n", live_counts[i], linear_churn(live_counts[i]));
+    }
+
+    uthread_init(BENCH_QUANTUM, live_counts[sizeof(live_counts) / sizeof(live_counts[0]) - 1] + 1);
+    for (size_t i = 0; i < sizeof(live_counts) / sizeof(live_counts[0]); i++) {
+        printf("uthread_spawn+terminate,%d,%.2f\n", live_counts[i], library_churn(live_counts[i]));
+    }
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * bench_trace.cpp - cost of scheduler tracing (-DUTHREADS_TRACE).
+ *
+ * Part 1 times TraceBuffer::record alone, the work the library adds per event. Part 2 times a uthread_yield
+ * ping-pong between two threads, one switch event each. "make bench" builds this file twice: bench_trace against
+ * the library without tracing and bench_trace_traced against the traced one, which also writes the ping-pong's
+ * events to TRACE_FILE as Chrome trace JSON.
+ *
+ * Output is CSV: build,which,ns
+ */
+
+#include <stdio.h>
+#include "bench.h"
+#include "Trace.h"
+#include "uthreads.h"
+
+#define EVENTS 10000000
+#define SWITCHES 1000000
+#define BENCH_QUANTUM 100000000 /* long enough that the timer never fires by itself */
+#define TRACE_FILE "/tmp/bench_trace.json"
+
+#ifdef UTHREADS_TRACE
+#define BUILD "traced"
+#else
+#define BUILD "plain"
+#endif
+
+static TraceBuffer buffer;
+
+static void yielder(void)
+{
+    while (1) {
+        uthread_yield();
+    }
+}
+
+int main(void)
+{
+    printf("build,which,ns\n");
+    buffer.start(1);
+    uint64_t start = now_ns();
+    for (int i = 0; i < EVENTS; i++) {
+        buffer.record(TRACE_SWITCH, i & 1023, 0, 0);
+    }
+    printf("%s,record_per_event,%.2f\n", BUILD, (double) (now_ns() - start) / EVENTS);
+
+    uthread_init(BENCH_QUANTUM);
+    int tid = uthread_spawn(yielder);
+    start = now_ns();
+    for (int i = 0; i < SWITCHES / 2; i++) {
+        uthread_yield();
+    }
+    printf("%s,yield_per_switch,%.2f\n", BUILD, (double) (now_ns() - start) / SWITCHES);
+    uthread_terminate(tid);
+#ifdef UTHREADS_TRACE
+    if (uthread_trace_dump(TRACE_FILE) < 0) {
+        return 1;
+    }
+#endif
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * bench_wait.cpp - uthread_wait/uthread_wake latency.
+ *
+ * - round_trip:  the main thread and one spawned thread take turns through one word, each waking the other and
+ *                waiting for its turn back; one round trip is two wakes, two waits and two switches.
+ * - wake_empty:  uthread_wake on an address nobody waits on.
+ * - wake_all:    one uthread_wake releasing every waiter of an address, for a growing number of waiters, while
+ *                DISTRACTORS other threads wait on addresses of their own. The cost per woken thread should not
+ *                depend on the distractors, nor grow with the number of waiters.
+ *
+ * Output is CSV: case,waiters,ns,ns_per_woken
+ */
+
+#include <stdio.h>
+#include <limits.h>
+#include "bench.h"
+#include "uthreads.h"
+
+#define ROUND_TRIPS 200000
+#define EMPTY_WAKES 1000000
+#define WAKE_REPS 200
+#define DISTRACTORS 1024
+#define MAX_WAITERS 1024
+#define BENCH_QUANTUM 100000000 /* long enough that the timer never fires by itself */
+
+static int turn = 0; /* 0: the main thread's turn, 1: the partner's */
+static int generation = 0;
+static int distractor_words[DISTRACTORS];
+
+static void set_word(int *word, int value)
+{
+    __atomic_store_n(word, value, __ATOMIC_RELEASE);
+}
+
+static int get_word(int *word)
+{
+    return __atomic_load_n(word, __ATOMIC_ACQUIRE);
+}
+
+static void partner(void)
+{
+    while (1) {
+        while (get_word(&turn) == 0) {
+            uthread_wait(&turn, 0);
+        }
+        set_word(&turn, 0);
+        uthread_wake(&turn, 1);
+    }
+}
+
+static void follower(void)
+{
+    while (1) {
+        int seen = get_word(&generation);
+        while (get_word(&generation) == seen) {
+            uthread_wait(&generation, seen);
+        }
+    }
+}
+
+static void distractor(void)
+{
+    int *word = &distractor_words[uthread_get_tid() % DISTRACTORS];
+    while (1) {
+        uthread_wait(word, 0);
+    }
+}
+
+static void report(const char *which, int waiters, uint64_t elapsed, long count, long woken)
+{
+    double ns = (double) elapsed / count;
+    printf("%s,%d,%.1f,%.1f\n", which, waiters, ns, woken > 0 ? (double) elapsed / woken : 0.0);
+}
+
+int main(void)
+{
+    uthread_init(BENCH_QUANTUM, 1 + 1 + DISTRACTORS + MAX_WAITERS);
+    printf("case,waiters,ns,ns_per_woken\n");
+
+    int tid = uthread_spawn(partner);
+    uthread_yield(); // the partner starts waiting for its turn
+    uint64_t start = now_ns();
+    for (int i = 0; i < ROUND_TRIPS; i++) {
+        set_word(&turn, 1);
+        uthread_wake(&turn, 1);
+        while (get_word(&turn) == 1) {
+            uthread_wait(&turn, 1);
+        }
+    }
+    report("round_trip", 1, now_ns() - start, ROUND_TRIPS, 0);
+    uthread_terminate(tid);
+
+    int nobody = 0;
+    start = now_ns();
+    for (int i = 0; i < EMPTY_WAKES; i++) {
+        uthread_wake(&nobody, 1);
+    }
+    report("wake_empty", 0, now_ns() - start, EMPTY_WAKES, 0);
+
+    for (int i = 0; i < DISTRACTORS; i++) {
+        uthread_spawn(distractor);
+    }
+    int waiters = 0;
+    for (int target = 1; target <= MAX_WAITERS; target *= 4) {
+        while (waiters < target) {
+            uthread_spawn(follower);
+            waiters++;
+        }
+        uthread_yield(); // every new thread (and distractor) starts waiting
+        uint64_t elapsed = 0;
+        long woken = 0;
+        for (int rep = 0; rep < WAKE_REPS; rep++) {
+            set_word(&generation, generation + 1);
+            start = now_ns();
+            woken += uthread_wake(&generation, INT_MAX);
+            elapsed += now_ns() - start;
+            uthread_yield(); // the followers see the new generation and wait for the next one
+        }
+        report("wake_all", waiters, elapsed, WAKE_REPS, woken);
+    }
+
+    uthread_terminate(0);
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * bench_workers.cpp - CPU-bound and yield-bound throughput on 1..N worker kernel threads.
+ *
+ * THREADS uthreads each run the same fixed amount of arithmetic, while the main thread yields until all of them
+ * are done. In the cpu workload they run it in one go, under ordinary timer preemption; in the yield workload they
+ * give up the CPU every YIELD_WORK steps, so the workers spend much of their time in the scheduler, switching
+ * between the threads on their deques under their own shares of the scheduler lock. uthread_init can only be
+ * called once per process, so every worker count runs in a forked child that reports its wall time back through a
+ * pipe. The speedup is relative to one worker and cannot exceed the number of cores the machine actually has.
+ *
+ * Usage: bench_workers [max_workers]   (default: the number of online CPUs)
+ * Output is CSV: workload,workers,ms,speedup
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <atomic>
+#include "bench.h"
+#include "uthreads.h"
+
+#define THREADS 64
+#define WORK_ITERATIONS 20000000UL
+#define YIELD_WORK 2000UL /* about a microsecond of arithmetic between two yields */
+#define BENCH_QUANTUM 10000 /* 10ms: threads are preempted, but rarely enough not to matter */
+
+static std::atomic<int> done(0);
+static volatile unsigned long results[THREADS];
+
+static void worker_thread(void)
+{
+    unsigned long x = (unsigned long) uthread_get_tid();
+    for (unsigned long i = 0; i < WORK_ITERATIONS; i++) {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+    }
+    results[uthread_get_tid() % THREADS] = x;
+    done.fetch_add(1);
+    uthread_terminate(uthread_get_tid());
+}
+
+static void yield_thread(void)
+{
+    unsigned long x = (unsigned long) uthread_get_tid();
+    for (unsigned long i = 0; i < WORK_ITERATIONS / YIELD_WORK / 4; i++) {
+        for (unsigned long j = 0; j < YIELD_WORK; j++) {
+            x = x * 6364136223846793005UL + 1442695040888963407UL;
+        }
+        uthread_yield();
+    }
+    results[uthread_get_tid() % THREADS] = x;
+    done.fetch_add(1);
+    uthread_terminate(uthread_get_tid());
+}
+
+/**
+ * Runs the workload (the entry point of its threads) on the given number of workers, in this (child) process.
+ * @return - wall time in nano-seconds, or 0 on failure.
+ */
+static uint64_t run(void (*workload)(void), int workers)
+{
+    if (uthread_init(BENCH_QUANTUM, THREADS + 1, workers) < 0) {
+        return 0;
+    }
+    uint64_t start = now_ns();
+    for (int i = 0; i < THREADS; i++) {
+        if (uthread_spawn(workload) < 0) {
+            return 0;
+        }
+    }
+    while (done.load() < THREADS) {
+        uthread_yield();
+    }
+    return now_ns() - start;
+}
+
+/**
+ * Prints the rows of one workload, from 1 to max_workers workers.
+ * @return - false on failure.
+ */
+static bool table(const char *name, void (*workload)(void), int max_workers)
+{
+    double base = 0;
+    for (int workers = 1; workers <= max_workers; workers++) {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            return false;
+        }
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            uint64_t elapsed = run(workload, workers);
+            if (write(fds[1], &elapsed, sizeof(elapsed)) != sizeof(elapsed)) {
+                _exit(1);
+            }
+            uthread_terminate(0);
+        }
+        close(fds[1]);
+        uint64_t elapsed = 0;
+        if (read(fds[0], &elapsed, sizeof(elapsed)) != sizeof(elapsed) || elapsed == 0) {
+            return false;
+        }
+        close(fds[0]);
+        waitpid(pid, NULL, 0);
+        double ms = elapsed / 1e6;
+        if (workers == 1) {
+            base = ms;
+        }
+        printf("%s,%d,%.1f,%.2f\n", name, workers, ms, base / ms);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    int max_workers = argc > 1 ? atoi(argv[1]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    if (max_workers < 1) {
+        max_workers = 1;
+    }
+    printf("workload,workers,ms,speedup\n");
+    if (!table("cpu", worker_thread, max_workers) || !table("yield", yield_thread, max_workers)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+ * bench_yield.cpp - two-thread ping-pong: uthread_yield vs. raising SIGVTALRM.
+ *
+ * The main thread and one spawned thread hand the CPU back and forth. With uthread_yield the switch is a
+ * direct user-space call; with kill(getpid(), SIGVTALRM) it goes through the kernel and the timer handler.
+ *
+ * Output is CSV: which,ns_per_switch,switches_per_sec
+ */
+
+#include <stdio.h>
+#include <signal.h>
+#include <unistd.h>
+#include "bench.h"
+#include "uthreads.h"
+
+#define SWITCHES 1000000
+#define BENCH_QUANTUM 100000000 /* long enough that the timer never fires by itself */
+
+static void yielder(void)
+{
+    while (1) {
+        uthread_yield();
+    }
+}
+
+static void signaller(void)
+{
+    while (1) {
+        kill(getpid(), SIGVTALRM);
+    }
+}
+
+static void report(const char *which, uint64_t elapsed, int switches)
+{
+    double per_switch = (double) elapsed / switches;
+    printf("%s,%.2f,%.0f\n", which, per_switch, 1e9 / per_switch);
+}
+
+int main(void)
+{
+    uthread_init(BENCH_QUANTUM);
+    printf("which,ns_per_switch,switches_per_sec\n");
+
+    int tid = uthread_spawn(yielder);
+    int first = uthread_get_total_quantums();
+    uint64_t start = now_ns();
+    for (int i = 0; i < SWITCHES / 2; i++) {
+        uthread_yield();
+    }
+    report("uthread_yield", now_ns() - start, uthread_get_total_quantums() - first);
+    uthread_terminate(tid);
+
+    tid = uthread_spawn(signaller);
+    first = uthread_get_total_quantums();
+    start = now_ns();
+    for (int i = 0; i < SWITCHES / 20; i++) {
+        kill(getpid(), SIGVTALRM);
+    }
+    report("sigvtalrm", now_ns() - start, uthread_get_total_quantums() - first);
+    uthread_terminate(tid);
+
+    uthread_terminate(0);
+    return 0;
+}
@@ -2,7 +2,10 @@
 #include <assert.h>
 # include <stdio.h>
 #include <sys/time.h>
+#include <sys/wait.h>
+#include <climits>
 #include <csignal>
+#include <cstring>
 #include <iostream>
 #include "uthreads.h" // TODO: If you get an error of "undefined reference to..." try to replace it with #include "uthreads.cpp"
 //#include "uthreads.cpp"
@@ -13,9 +16,18 @@
 
 using namespace std;
 
+// the policy of the library the tests are linked against; make tests builds them once per policy
+#ifndef TEST_POLICY
+#define TEST_POLICY "default"
+#endif
+
 
 int QUANTOM = 1000000;
 
+bool policy_is(const char *policy){
+    return strcmp(TEST_POLICY, policy) == 0;
+}
+
 void send_sigalarm(){
     kill(getpid(),SIGVTALRM);
 }
@@ -25,6 +37,23 @@ void kill_yourself_entry_point(){
     uthread_terminate(uthread_get_tid());
 }
 
+// runs test in a child process on a library of its own: uthread_init is once per process, so main calls these
+// before test_init
+void run_in_child(void (*test)(), int quantum_usecs, int num_workers){
+    fflush(stdout);
+    pid_t pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        uthread_init(quantum_usecs, MAX_THREAD_NUM, num_workers);
+        test();
+        fflush(stdout);
+        _exit(0);
+    }
+    int status;
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
 void test_init(){
     uthread_init(QUANTOM);
     assert(uthread_get_tid() == MAIN_THREAD);
@@ -155,12 +184,716 @@ void test_block_sleeping_thread(){
     printf("Passed Block Sleeping thread Test!\n");
 }
 
+void big_stack_entry_point(){
+    volatile char buf[256 * 1024];
+    for (size_t i = 0; i < sizeof(buf); i += 4096){
+        buf[i] = 1;
+    }
+    assert(uthread_get_stack_committed(uthread_get_tid()) >= (long) sizeof(buf));
+    uthread_terminate(uthread_get_tid());
+}
+
+void test_spawn_ex_stack_size(){
+    uthread_attr_t attrs = {1024 * 1024};
+    int tid = uthread_spawn_ex(big_stack_entry_point, &attrs);
+    assert(tid != FAILURE);
+    // a stack of its own, reserved and not committed yet; a recycled STACK_SIZE one may keep its earlier owners' pages
+    assert(uthread_get_stack_committed(tid) < 64 * 1024);
+    assert(uthread_get_stack_committed(MAIN_THREAD) == 0);
+    send_sigalarm(); // the new thread fills 256KB of its stack and terminates itself
+    assert(uthread_get_tid() == MAIN_THREAD);
+    printf("Passed spawn_ex Stack Size Test!\n");
+}
+
+int yield_step = 0;
+
+void yield_entry_point(){
+    yield_step = 1;
+    uthread_yield();
+    yield_step = 2;
+    uthread_terminate(uthread_get_tid());
+}
+
+void test_yield(){
+    int quantums = uthread_get_total_quantums();
+    uthread_spawn(yield_entry_point);
+    assert(uthread_yield() == SUCCESS);
+    if (policy_is("mlfq") || policy_is("cfs")) {
+        // the main thread sank to a low level, or ran up a large virtual runtime, in the tests above: the new
+        // thread stays ahead of it when it yields, and finishes first
+        assert(yield_step == 2);
+        assert(uthread_get_total_quantums() == quantums + 3);
+    } else {
+        // the new thread ran until it yielded back
+        assert(yield_step == 1);
+        assert(uthread_get_total_quantums() == quantums + 2);
+        uthread_yield(); // the thread finishes
+        assert(yield_step == 2);
+    }
+    assert(uthread_get_tid() == MAIN_THREAD);
+    printf("Passed Yield Test!\n");
+}
+
+uthread_mutex_t mutex = UTHREAD_MUTEX_INITIALIZER;
+int mutex_counter = 0;
+
+void mutex_entry_point(){
+    uthread_mutex_lock(&mutex); // held by the main thread: parks
+    mutex_counter++;
+    uthread_mutex_unlock(&mutex);
+    uthread_terminate(uthread_get_tid());
+}
+
+void test_mutex(){
+    assert(uthread_mutex_lock(&mutex) == SUCCESS);
+    int tid = uthread_spawn(mutex_entry_point);
+    uthread_yield(); // the new thread parks on the mutex and the main thread gets the CPU back
+    assert(uthread_get_quantums(tid) == 1);
+    uthread_yield(); // a parked thread is not scheduled
+    assert(uthread_get_quantums(tid) == 1);
+    assert(uthread_mutex_trylock(&mutex) == 1);
+    mutex_counter = 10;
+    assert(uthread_mutex_unlock(&mutex) == SUCCESS);
+    uthread_yield(); // the woken thread takes the mutex and terminates
+    assert(mutex_counter == 11);
+    assert(uthread_mutex_trylock(&mutex) == 0);
+    assert(uthread_mutex_unlock(&mutex) == SUCCESS);
+    printf("Passed Mutex Test!\n");
+}
+
+uthread_cond_t cond = UTHREAD_COND_INITIALIZER;
+bool cond_ready = false;
+int cond_woken = 0;
+
+void cond_entry_point(){
+    uthread_mutex_lock(&mutex);
+    while (!cond_ready) {
+        uthread_cond_wait(&cond, &mutex);
+    }
+    cond_woken++;
+    uthread_mutex_unlock(&mutex);
+    uthread_terminate(uthread_get_tid());
+}
+
+void test_cond(){
+    int first = uthread_spawn(cond_entry_point);
+    int second = uthread_spawn(cond_entry_point);
+    uthread_yield(); // both threads wait on the condition variable
+    uthread_yield();
+    assert(uthread_get_quantums(first) == 1 && uthread_get_quantums(second) == 1);
+    assert(uthread_cond_signal(&cond) == SUCCESS); // wakes the first, which checks the condition again
+    uthread_yield();
+    assert(uthread_get_quantums(first) == 2 && uthread_get_quantums(second) == 1 && cond_woken == 0);
+    uthread_mutex_lock(&mutex);
+    cond_ready = true;
+    assert(uthread_cond_broadcast(&cond) == SUCCESS);
+    uthread_mutex_unlock(&mutex);
+    uthread_yield();
+    uthread_yield();
+    assert(cond_woken == 2);
+    assert(uthread_get_tid() == MAIN_THREAD);
+    printf("Passed Condition Variable Test!\n");
+}
+
+int wait_word = 0;
+int wait_woken = 0;
+
+void wait_entry_point(){
+    while (wait_word == 0) {
+        uthread_wait(&wait_word, 0);
+    }
+    wait_woken++;
+    uthread_terminate(uthread_get_tid());
+}
+
+void test_wait_wake(){
+    int first = uthread_spawn(wait_entry_point);
+    int second = uthread_spawn(wait_entry_point);
+    uthread_yield(); // both threads wait on wait_word
+    assert(uthread_wait(&wait_word, 1) == 1); // the value differs: returns at once
+    assert(uthread_wake(&wait_word, 1) == 1); // spurious for the first thread: it waits again behind the second
+    uthread_yield();
+    assert(uthread_get_quantums(first) == 2 && uthread_get_quantums(second) == 1);
+    wait_word = 1;
+    assert(uthread_wake(&wait_word, 10) == 2);
+    assert(uthread_wake(&wait_word, 10) == 0);
+    uthread_yield();
+    assert(wait_woken == 2);
+    printf("Passed Wait/Wake Test!\n");
+}
+
+uthread_chan_t *channel;
+int received[3];
+
+void channel_entry_point(){
+    for (int i = 0; i < 3; i++) {
+        uthread_chan_recv(channel, &received[i]);
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+void test_channel(){
+    channel = uthread_chan_create(sizeof(int), 1);
+    assert(channel != NULL);
+    int value = 0;
+    assert(uthread_chan_try_recv(channel, &value) == 1);
+    uthread_spawn(channel_entry_point);
+    for (value = 1; value <= 3; value++) {
+        assert(uthread_chan_send(channel, &value) == SUCCESS); // the second send waits for the receiver
+    }
+    uthread_yield();
+    assert(received[0] == 1 && received[1] == 2 && received[2] == 3);
+    value = 4;
+    assert(uthread_chan_try_send(channel, &value) == 0);
+    assert(uthread_chan_try_send(channel, &value) == 1); // full
+    assert(uthread_chan_try_recv(channel, &value) == 0 && value == 4);
+    assert(uthread_chan_destroy(channel) == SUCCESS);
+    uthread_chan_t *unbuffered = uthread_chan_create(sizeof(int), 0);
+    assert(uthread_chan_try_send(unbuffered, &value) == 1); // nobody receives
+    assert(uthread_chan_destroy(unbuffered) == SUCCESS);
+    printf("Passed Channel Test!\n");
+}
+
+int switch_order[2];
+int switch_count = 0;
+
+void switch_entry_point(){
+    switch_order[switch_count++] = uthread_get_tid();
+    uthread_terminate(uthread_get_tid());
+}
+
+void test_switch_to(){
+    int first = uthread_spawn(switch_entry_point);
+    int second = uthread_spawn(switch_entry_point);
+    // the second thread runs ahead of the first; the main thread queues behind both
+    assert(uthread_switch_to(second) == SUCCESS);
+    assert(switch_count == 2 && switch_order[0] == second && switch_order[1] == first);
+    printf("Passed Switch To Test!\n");
+}
+
+void test_set_priority(){
+    int tid = uthread_spawn(kill_yourself_entry_point);
+    assert(uthread_set_priority(tid, UTHREAD_PRIORITIES - 1) == SUCCESS);
+    assert(uthread_set_priority(MAIN_THREAD, 0) == SUCCESS);
+    assert(uthread_set_priority(tid, UTHREAD_PRIORITIES) == FAILURE); // prints a library error message
+    assert(uthread_set_priority(tid, -1) == FAILURE); // prints a library error message
+    assert(uthread_terminate(tid) == SUCCESS);
+    printf("Passed Set Priority Test!\n");
+}
+
+void test_runtime_and_weight(){
+    long before = uthread_get_runtime(MAIN_THREAD);
+    assert(before > 0);
+    int tid = uthread_spawn(kill_yourself_entry_point);
+    assert(uthread_get_runtime(tid) == 0); // has not run yet
+    assert(uthread_set_weight(tid, 2 * UTHREAD_DEFAULT_WEIGHT) == SUCCESS);
+    assert(uthread_set_weight(tid, 0) == FAILURE); // prints a library error message
+    assert(uthread_set_weight(tid, -UTHREAD_DEFAULT_WEIGHT) == FAILURE); // prints a library error message
+    assert(uthread_terminate(tid) == SUCCESS);
+    assert(uthread_get_runtime(MAIN_THREAD) >= before);
+    printf("Passed Runtime And Weight Test!\n");
+}
+
+int periods_done = 0;
+
+void periodic_entry_point(){
+    for (int i = 0; i < 3; i++) {
+        assert(uthread_wait_period() == SUCCESS);
+    }
+    assert(uthread_get_deadline_misses(uthread_get_tid()) >= 0);
+    periods_done = 1;
+    uthread_wake(&periods_done, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+void test_deadline(){
+    int tid = uthread_spawn(periodic_entry_point);
+    assert(uthread_set_deadline(tid, 1000, 1001) == FAILURE); // budget over the period: a library error message
+    assert(uthread_set_deadline(tid, 1000, 500) == SUCCESS);
+    assert(uthread_get_deadline_misses(tid) == 0);
+    while (periods_done == 0) {
+        uthread_wait(&periods_done, 0); // three periods of 1ms, on the monotonic clock
+    }
+    printf("Passed Deadline Test!\n");
+}
+
+int timed_sleep_done = 0;
+
+long elapsed_us(const struct timespec &start){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) * 1000000L + (now.tv_nsec - start.tv_nsec) / 1000;
+}
+
+void timed_sleep_entry_point(){
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    assert(uthread_sleep_for(2000) == SUCCESS);
+    assert(elapsed_us(start) >= 2000);
+    struct timespec deadline = start;
+    deadline.tv_nsec += 5000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+    assert(uthread_sleep_until(&deadline) == SUCCESS);
+    assert(elapsed_us(start) >= 5000);
+    assert(uthread_sleep_until(&start) == SUCCESS); // in the past: only gives up the CPU
+    timed_sleep_done = 1;
+    uthread_wake(&timed_sleep_done, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+int forever_woken = 0;
+
+void sleep_forever_entry_point(){
+    // too far away to fit in nanoseconds: sleeps for good rather than wrapping around to a deadline gone by
+    if (uthread_get_tid() % 2 == 0) {
+        uthread_sleep_for(LONG_MAX);
+    } else {
+        struct timespec deadline = {LONG_MAX, 999999999};
+        uthread_sleep_until(&deadline);
+    }
+    forever_woken = 1;
+    uthread_terminate(uthread_get_tid());
+}
+
+void test_sleep_for_until(){
+    uthread_spawn(timed_sleep_entry_point);
+    while (timed_sleep_done == 0) {
+        uthread_wait(&timed_sleep_done, 0);
+    }
+    int sleepers[2] = {uthread_spawn(sleep_forever_entry_point), uthread_spawn(sleep_forever_entry_point)};
+    for (int i = 0; i < 10; i++) {
+        uthread_yield();
+    }
+    assert(forever_woken == 0);
+    assert(uthread_terminate(sleepers[0]) == SUCCESS);
+    assert(uthread_terminate(sleepers[1]) == SUCCESS);
+    printf("Passed Sleep For/Until Test!\n");
+}
+
+int io_pipe[2];
+int io_done = 0;
+
+void io_reader_entry_point(){
+    char buf[4];
+    assert(uthread_read(io_pipe[0], buf, sizeof(buf)) == 4); // parks until the main thread writes
+    assert(buf[0] == 'p' && buf[3] == 'g');
+    assert(uthread_read(io_pipe[0], buf, sizeof(buf)) == 0); // end of file once the write end is closed
+    close(io_pipe[0]);
+    io_done = 1;
+    uthread_wake(&io_done, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+void test_io(){
+    assert(pipe(io_pipe) == 0);
+    int tid = uthread_spawn(io_reader_entry_point);
+    assert(uthread_switch_to(tid) == SUCCESS);
+    assert(uthread_write(io_pipe[1], "ping", 4) == 4);
+    close(io_pipe[1]);
+    while (io_done == 0) {
+        uthread_wait(&io_done, 0);
+    }
+    printf("Passed IO Test!\n");
+}
+
+int file_fd;
+int file_done = 0;
+
+void file_entry_point(){
+    char buf[5] = {0};
+    assert(uthread_pwrite(file_fd, "uthr", 4, 4096) == 4); // parks until the write completes
+    assert(uthread_pread(file_fd, buf, 4, 4096) == 4);
+    assert(buf[0] == 'u' && buf[3] == 'r');
+    assert(uthread_pread(file_fd, buf, 4, 8192) == 0); // past the end of the file
+    file_done = 1;
+    uthread_wake(&file_done, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+void test_file_io(){
+    char name[] = "/tmp/uthreads_file_XXXXXX";
+    file_fd = mkstemp(name);
+    assert(file_fd >= 0);
+    unlink(name);
+    uthread_spawn(file_entry_point);
+    while (file_done == 0) {
+        uthread_wait(&file_done, 0);
+    }
+    close(file_fd);
+    printf("Passed File IO Test!\n");
+}
+
+#ifndef UTHREADS_PERIODIC_TICK
+#define IO_TICKLESS_QUANTOM 10000
+
+struct sigaction library_tick;
+int io_ticks = 0;
+
+void counting_tick(int sig){
+    io_ticks++;
+    library_tick.sa_handler(sig);
+}
+
+void io_parked_entry_point(){
+    char buf[1];
+    uthread_read(io_pipe[0], buf, sizeof(buf)); // parks for good: nothing is ever written
+}
+
+void io_terminate_tickless(){
+    assert(pipe(io_pipe) == 0);
+    int tid = uthread_spawn(io_parked_entry_point);
+    assert(uthread_switch_to(tid) == SUCCESS); // back here once it parked
+    assert(uthread_terminate(tid) == SUCCESS);
+    // alone, with no descriptor left to poll: after a quantum the main thread runs without ticks
+    assert(sigaction(SIGVTALRM, nullptr, &library_tick) == 0);
+    struct sigaction counting = library_tick;
+    counting.sa_handler = counting_tick;
+    assert(sigaction(SIGVTALRM, &counting, nullptr) == 0);
+    int total = uthread_get_total_quantums();
+    while (uthread_get_total_quantums() < total + 10) {
+    }
+    assert(sigaction(SIGVTALRM, &library_tick, nullptr) == 0);
+    assert(io_ticks <= 2);
+    close(io_pipe[0]);
+    close(io_pipe[1]);
+}
+
+void test_io_terminate_tickless(){
+    run_in_child(io_terminate_tickless, IO_TICKLESS_QUANTOM, 1);
+    printf("Passed IO Terminate Tickless Test!\n");
+}
+#endif
+
+int tickless_ran = 0;
+
+void tickless_entry_point(){
+    tickless_ran = 1;
+    uthread_terminate(uthread_get_tid());
+}
+
+void test_tickless(){
+    // alone, the main thread runs tickless after its first full quantum: the quantums still count
+    int total = uthread_get_total_quantums();
+    int own = uthread_get_quantums(MAIN_THREAD);
+    while (uthread_get_total_quantums() < total + 2) {
+    }
+    assert(uthread_get_quantums(MAIN_THREAD) - own == uthread_get_total_quantums() - total);
+    // competition arms the timer again, and the new thread gets the CPU
+    uthread_spawn(tickless_entry_point);
+    timeval start;
+    timeval end;
+    gettimeofday(&start, nullptr);
+    while (*(volatile int *) &tickless_ran == 0) {
+        gettimeofday(&end, nullptr);
+        assert(end.tv_sec - start.tv_sec <= (QUANTOM / 1000000) + 1);
+    }
+    printf("Passed Tickless Test!\n");
+}
+
+#ifdef UTHREADS_TRACE
+void test_trace(){
+    // every test above ran traced: the dump is a Chrome trace naming the main thread's track
+    char name[] = "/tmp/uthreads_trace_XXXXXX";
+    int fd = mkstemp(name);
+    assert(fd >= 0);
+    close(fd);
+    assert(uthread_trace_dump(name) == SUCCESS);
+    char buf[64] = {0};
+    FILE *trace = fopen(name, "r");
+    assert(trace != nullptr && fread(buf, 1, sizeof(buf) - 1, trace) > 0);
+    fclose(trace);
+    unlink(name);
+    assert(string(buf).find("{\"traceEvents\":[") == 0);
+    assert(uthread_trace_dump("/nonexistent/trace.json") == FAILURE); // prints a library error message
+    printf("Passed Trace Test!\n");
+}
+#endif
+
+// the tests below run with several workers
+#define WORKERS 4
+#define WORKERS_QUANTOM 1000
+
+volatile long spin_count = 0;
+
+void spin_entry_point(){
+    while (true) {
+        spin_count++;
+    }
+}
+
+// polls spin_count while the main thread's kernel thread sleeps, so the other workers have the CPU
+bool spinner_moving(bool moving){
+    for (int i = 0; i < 100; i++) {
+        long before = spin_count;
+        usleep(20000);
+        if ((spin_count != before) == moving) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void workers_terminate(){
+    int tid = uthread_spawn(spin_entry_point);
+    assert(spinner_moving(true)); // running on another worker
+    assert(uthread_terminate(tid) == SUCCESS); // that worker switches away at its next tick
+    assert(spinner_moving(false));
+    assert(uthread_spawn(kill_yourself_entry_point) != FAILURE);
+}
+
+void test_workers_terminate(){
+    run_in_child(workers_terminate, WORKERS_QUANTOM, WORKERS);
+    printf("Passed Workers Terminate Test!\n");
+}
+
+void workers_block_resume(){
+    int tid = uthread_spawn(spin_entry_point);
+    assert(spinner_moving(true));
+    assert(uthread_block(tid) == SUCCESS);
+    assert(spinner_moving(false));
+    assert(uthread_resume(tid) == SUCCESS); // an idle worker picks it up
+    assert(spinner_moving(true));
+    assert(uthread_terminate(tid) == SUCCESS);
+}
+
+void test_workers_block_resume(){
+    run_in_child(workers_block_resume, WORKERS_QUANTOM, WORKERS);
+    printf("Passed Workers Block/Resume Test!\n");
+}
+
+#define WORKERS_MUTEX_THREADS 8
+#define WORKERS_MUTEX_ROUNDS 20000
+
+uthread_mutex_t workers_lock = UTHREAD_MUTEX_INITIALIZER;
+volatile int workers_counter = 0;
+int workers_done = 0;
+
+void workers_mutex_entry_point(){
+    for (int i = 0; i < WORKERS_MUTEX_ROUNDS; i++) {
+        uthread_mutex_lock(&workers_lock);
+        int value = workers_counter; // a lost update shows in the total
+        workers_counter = value + 1;
+        uthread_mutex_unlock(&workers_lock);
+    }
+    __sync_fetch_and_add(&workers_done, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+void workers_mutex(){
+    for (int i = 0; i < WORKERS_MUTEX_THREADS; i++) {
+        assert(uthread_spawn(workers_mutex_entry_point) != FAILURE);
+    }
+    while (*(volatile int *) &workers_done < WORKERS_MUTEX_THREADS) {
+        uthread_yield();
+    }
+    assert(workers_counter == WORKERS_MUTEX_THREADS * WORKERS_MUTEX_ROUNDS);
+}
+
+void test_workers_mutex(){
+    run_in_child(workers_mutex, WORKERS_QUANTOM, WORKERS);
+    printf("Passed Workers Mutex Test!\n");
+}
+
+#define WORKERS_YIELD_THREADS 16
+#define WORKERS_YIELD_ROUNDS 20000
+
+int workers_yields_done = 0;
+
+void yield_forever_entry_point(){
+    while (true) {
+        uthread_yield();
+    }
+}
+
+void workers_yield_entry_point(){
+    for (int i = 0; i < WORKERS_YIELD_ROUNDS; i++) {
+        uthread_yield();
+    }
+    __sync_fetch_and_add(&workers_yields_done, 1);
+    uthread_terminate(uthread_get_tid());
+}
+
+// with the FIFO policy the yields only take their workers' shares of the scheduler lock; the terminations take the
+// whole lock, and hit threads running on other workers and threads queued on the deques
+void workers_yield(){
+    int victims[WORKERS_YIELD_THREADS];
+    for (int i = 0; i < WORKERS_YIELD_THREADS; i++) {
+        victims[i] = uthread_spawn(yield_forever_entry_point);
+        assert(victims[i] != FAILURE);
+        assert(uthread_spawn(workers_yield_entry_point) != FAILURE);
+    }
+    for (int i = 0; i < WORKERS_YIELD_THREADS; i++) {
+        uthread_yield();
+        assert(uthread_terminate(victims[i]) == SUCCESS);
+    }
+    while (*(volatile int *) &workers_yields_done < WORKERS_YIELD_THREADS) {
+        uthread_yield();
+    }
+}
+
+void test_workers_yield(){
+    run_in_child(workers_yield, WORKERS_QUANTOM, WORKERS);
+    printf("Passed Workers Yield Test!\n");
+}
+
+// the tests below check the scheduling policy's own behaviour; each runs only against that policy's library
+#define POLICY_QUANTOM 1000000 // a quantum only ends early: with send_sigalarm, or a real-time budget
+
+#define MLFQ_LOG 150
+#define MLFQ_BOOST 50 // MlfqPolicy boosts every thread back to its priority this often (quantums)
+
+char mlfq_log[MLFQ_LOG];
+int mlfq_logged = 0;
+
+void mlfq_cpu_entry_point(){
+    // uses up every quantum, so it sinks a level each time
+    while (mlfq_logged < MLFQ_LOG) {
+        mlfq_log[mlfq_logged++] = 'C';
+        send_sigalarm();
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+void mlfq_io_entry_point(){
+    // gives up every quantum early, so it stays at the level of its priority
+    while (mlfq_logged < MLFQ_LOG) {
+        mlfq_log[mlfq_logged++] = 'I';
+        uthread_yield();
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+void mlfq_levels(){
+    assert(uthread_set_priority(MAIN_THREAD, UTHREAD_PRIORITIES - 1) == SUCCESS); // out of the way
+    uthread_spawn(mlfq_cpu_entry_point);
+    uthread_spawn(mlfq_io_entry_point);
+    while (mlfq_logged < MLFQ_LOG) {
+        uthread_yield();
+    }
+    // both start on the top level, in FIFO order
+    assert(mlfq_log[0] == 'C' && mlfq_log[1] == 'I');
+    int cpu_runs = 0;
+    int io_streak = 0;
+    int longest_io_streak = 0;
+    for (int i = 0; i < MLFQ_LOG; i++) {
+        if (mlfq_log[i] == 'C') {
+            assert(i == 0 || mlfq_log[i - 1] == 'I'); // demoted at once, it never runs twice in a row
+            cpu_runs++;
+            io_streak = 0;
+        } else {
+            longest_io_streak = max(longest_io_streak, ++io_streak);
+        }
+    }
+    // once demoted, the CPU-bound thread only runs again after a boost
+    assert(cpu_runs >= 2 && cpu_runs <= MLFQ_LOG / MLFQ_BOOST + 2);
+    assert(longest_io_streak >= MLFQ_BOOST - 10);
+}
+
+void test_mlfq_levels(){
+    run_in_child(mlfq_levels, POLICY_QUANTOM, 1);
+    printf("Passed MLFQ Levels Test!\n");
+}
+
+#define CFS_LOG 80
+#define CFS_SPIN 200000
+
+char cfs_log[CFS_LOG];
+int cfs_logged = 0;
+int cfs_heavy;
+
+void cfs_entry_point(){
+    char mark = uthread_get_tid() == cfs_heavy ? 'H' : 'L';
+    while (cfs_logged < CFS_LOG) {
+        cfs_log[cfs_logged++] = mark;
+        for (volatile int i = 0; i < CFS_SPIN; i++) {
+        } // about the same run time every time
+        send_sigalarm();
+    }
+    uthread_terminate(uthread_get_tid());
+}
+
+void cfs_weights(){
+    uthread_spawn(cfs_entry_point);
+    cfs_heavy = uthread_spawn(cfs_entry_point);
+    assert(uthread_set_weight(cfs_heavy, 3 * UTHREAD_DEFAULT_WEIGHT) == SUCCESS);
+    while (cfs_logged < CFS_LOG) {
+        uthread_yield();
+    }
+    int heavy = 0;
+    for (int i = 0; i < CFS_LOG; i++) {
+        heavy += cfs_log[i] == 'H';
+    }
+    int light = CFS_LOG - heavy;
+    // the heavy thread's virtual runtime grows three times slower, so it runs about three times as often
+    assert(heavy >= 2 * light && heavy <= 4 * light);
+}
+
+void test_cfs_weights(){
+    run_in_child(cfs_weights, POLICY_QUANTOM, 1);
+    printf("Passed CFS Weights Test!\n");
+}
+
+#define EDF_QUANTOM 100000
+#define EDF_PERIOD 200000
+#define EDF_BUDGET 10000
+
+volatile int edf_background_ran = 0;
+volatile int edf_done = 0;
+long edf_ran_ahead = 0;
+
+void edf_overrun_entry_point(){
+    // a job that wants far more than its budget: it runs ahead of the main thread only for that budget
+    long start = uthread_get_runtime(uthread_get_tid());
+    long ran = 0;
+    while (!edf_background_ran && ran < 2 * EDF_QUANTOM * 1000L) {
+        ran = uthread_get_runtime(uthread_get_tid()) - start;
+    }
+    edf_ran_ahead = ran;
+    edf_done = 1;
+    uthread_terminate(uthread_get_tid());
+}
+
+void edf_budget(){
+    int tid = uthread_spawn(edf_overrun_entry_point);
+    assert(uthread_set_deadline(tid, EDF_PERIOD, EDF_BUDGET) == SUCCESS);
+    uthread_yield(); // the job runs first
+    while (!edf_done) {
+        edf_background_ran = 1;
+    }
+    // cut off when its budget ran out (at the kernel's next tick), not at the end of the quantum
+    assert(edf_ran_ahead >= EDF_BUDGET * 1000L && edf_ran_ahead < EDF_QUANTOM * 1000L / 2);
+}
+
+void test_edf_budget(){
+    run_in_child(edf_budget, EDF_QUANTOM, 1);
+    printf("Passed EDF Budget Test!\n");
+}
+
 void test_send_main_thread_to_sleep(){
     assert(uthread_sleep(2) == FAILURE);
     printf("Passed Send Main Thread To Sleep Test!\n");
 }
 
 int main(){
+    test_workers_terminate();
+    test_workers_block_resume();
+    test_workers_mutex();
+    test_workers_yield();
+#ifndef UTHREADS_PERIODIC_TICK
+    test_io_terminate_tickless();
+#endif
+    if (policy_is("mlfq")) {
+        test_mlfq_levels();
+    }
+    if (policy_is("cfs")) {
+        test_cfs_weights();
+    }
+    if (policy_is("edf")) {
+        test_edf_budget();
+    }
     test_init();
     test_timer();
     test_spawn();
@@ -170,7 +903,26 @@ int main(){
     test_resume();
     test_sleep();
     test_block_sleeping_thread();
+    test_spawn_ex_stack_size();
+    test_yield();
+    test_mutex();
+    test_cond();
+    test_wait_wake();
+    test_channel();
+    test_switch_to();
+    test_set_priority();
+    test_runtime_and_weight();
+    test_deadline();
+    test_sleep_for_until();
+    test_io();
+    test_file_io();
+    test_tickless();
     test_send_main_thread_to_sleep();
-    cout << "There should be 2 library error messages" << endl;
+#ifdef UTHREADS_TRACE
+    test_trace();
+    cout << "There should be 8 library error messages" << endl;
+#else
+    cout << "There should be 7 library error messages" << endl;
+#endif
     uthread_terminate(0);
 }
\ No newline at end of file
@@ -1,12 +1,55 @@
+#include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
 #include "Thread.h"
+#include "TidBitmap.h"
+#include "ReadyQueue.h"
+#include "RunQueue.h"
+#include "SleepQueue.h"
+#include "WaitTable.h"
+#include "Channel.h"
+#include "IoReactor.h"
+#include "FileIo.h"
+#include "StackPool.h"
+#include "ThreadTable.h"
+#include "SpinLock.h"
+#include "SchedLock.h"
+#include "Worker.h"
+#include "Trace.h"
 #include "uthreads.h"
 #include <iostream>
-#include <deque>
 
 ////////////////// consts ////////////////////
 #define MAIN_THREAD 0
+#define IDLE_TID (-1)
+#define IDLE_STACK_SIZE (64 * 1024)
 #define TIME_SET 1000000
+#define NSEC_PER_USEC 1000
+#define NSEC_PER_SEC 1000000000ULL
+#define QUANTUM_EXPIRED 1 // quantum_update_func: the running thread used up its quantum
+#define WAKE_SIGNAL SIGRTMIN // signal of wake_timer (see wake_handler)
+#ifdef UTHREADS_STACK_HUGEPAGES
+#define STACK_HUGE_PAGES true
+#else
+#define STACK_HUGE_PAGES false
+#endif
+#ifdef UTHREADS_PERIODIC_TICK
+#define TICKLESS false // the quantum timer ticks every quantum, whether or not the running thread has competition
+#else
+#define TICKLESS true
+#endif
 
 ///////////////// errors code ////////////////
 #define ERR_MSG "error"
@@ -16,25 +59,105 @@
 ///////////////// errors /////////////////////
 #define LIBRARY_ERR "thread library error: "
 #define SYSTEM_ERR "system error: "
-#define SIGPROCMASK_ERR "could not execute sigprocmask appropriately"
 #define SETITIMER_ERR "could not execute setitimer appropriately"
 #define SIGACTION_ERR "could not execute sigaction appropriately"
+#define TIMER_CREATE_ERR "could not execute timer_create appropriately"
+#define PTHREAD_CREATE_ERR "could not execute pthread_create appropriately"
 #define INVALID_THREAD_ERR "Thread Invalid"
+#define NOT_READY_ERR "Thread is not READY"
+#define INVALID_PRIORITY_ERR "Invalid priority"
+#define INVALID_WEIGHT_ERR "Invalid weight"
+#define INVALID_DEADLINE_ERR "Invalid period or budget"
+#define INVALID_SLEEP_ERR "Invalid sleep time"
+#define NOT_REAL_TIME_ERR "Thread has no deadline"
 #define NO_FREE_TID_ERR "No free TID"
+#define NO_STACK_ERR "No memory for a thread stack"
 #define NO_ENTRY_POINT_ERR "No entry poiny given"
 #define INVALID_QUANTUM_ERR "Invalid quantum"
+#define INVALID_MAX_THREADS_ERR "Invalid thread limit"
+#define INVALID_WORKERS_ERR "Invalid number of workers"
 #define MAIN_SLEEP_ERR "cannot send main thread to sleep"
+#define INVALID_MUTEX_ERR "Invalid mutex"
+#define MUTEX_NOT_LOCKED_ERR "Mutex is not locked"
+#define INVALID_COND_ERR "Invalid condition variable"
+#define INVALID_ADDRESS_ERR "Invalid wait address"
+#define INVALID_CHANNEL_ERR "Invalid channel"
+#define INVALID_CHANNEL_SIZE_ERR "Invalid channel element size or capacity"
+#define INVALID_ELEMENT_ERR "Invalid channel element"
+#define CHANNEL_IN_USE_ERR "Channel has waiting threads"
+#define TRACE_DISABLED_ERR "Tracing is not built in"
+#define TRACE_FILE_ERR "Could not write the trace file"
+
+///////////////// mutex states ///////////////
+#define MUTEX_UNLOCKED 0
+#define MUTEX_LOCKED 1
+#define MUTEX_CONTENDED 2 // locked, and threads may be parked on it
+
+///////////////// scheduler lock holds ///////
+#define SCHED_UNLOCKED 0
+#define SCHED_SHARE 1 // this worker's share of sched_lock (see switch_shared)
+#define SCHED_WHOLE 2
 
 ///////////////// global var /////////////////
 
-Thread *thread_array[MAX_THREAD_NUM];
-int sleeping_threads[MAX_THREAD_NUM];
+// everything shared between workers; only touched inside the library, with the whole sched_lock held
+ThreadTable thread_array;
+TidBitmap free_tids(MAX_THREAD_NUM);
+SleepQueue sleeping_threads(MAX_THREAD_NUM);
+// threads sleeping until a time on CLOCK_MONOTONIC (uthread_sleep_for, uthread_sleep_until), and real-time threads
+// waiting for the release of their next job (uthread_wait_period), keyed on that time in ns
+SleepQueue timed_sleepers(MAX_THREAD_NUM);
+// CLOCK_MONOTONIC timer that signals worker 0 when the first of timed_sleepers is due, and the time it is armed
+// for (0: not armed)
+timer_t wake_timer;
+uint64_t wake_timer_at = 0;
+WaitTable wait_table;
+// threads parked on file descriptors by uthread_read and friends
+IoReactor io_reactor;
+// file reads and writes in flight (uthread_pread, uthread_pwrite)
+FileIo file_io;
+// an idle worker sleeps in the reactor instead of on work_seq; wake_idle_worker interrupts it through the reactor
+bool io_polling = false;
+// the READY threads, except in work-stealing mode (several workers and a FIFO policy), where each worker has a deque
+SchedQueue run_queue;
+StackPool stack_pool(STACK_SIZE, STACK_HUGE_PAGES);
+// stack_pool.release: workers free terminated threads at the same time, each under its share of sched_lock
+SpinLock stack_lock;
 struct sigaction sig_act;
+struct sigaction wake_act;
+sigset_t timer_signal_set; // SIGVTALRM alone
 struct itimerval itimer;
-std::deque<Thread *> ready_threads;
-Thread *current_thread = nullptr;
-sigset_t signal_set;
-int total_quantums = 0;
+struct itimerspec quantum_spec;
+uint64_t quantum_ns;
+Worker *workers = nullptr;
+int worker_count = 1;
+int idle_workers = 0;
+// bumped whenever work is queued while a worker is idle; idle workers futex-wait on it
+std::atomic<int> work_seq(0);
+// counted at the same time by workers switching under their shares of sched_lock
+std::atomic<int> total_quantums(0);
+SchedLock sched_lock;
+#ifdef UTHREADS_TRACE
+// scheduler events for uthread_trace_dump; recorded inside the library, on the worker the event happens on
+TraceBuffer trace_buffer;
+#define TRACE_EVENT(type, tid, other) trace_buffer.record(type, tid, other, self_worker->index)
+#else
+#define TRACE_EVENT(type, tid, other) ((void) 0)
+#endif
+
+// per kernel thread. A uthread may move to another worker at any switch, so these are always read afresh
+// (thread_local accesses go through %fs and are never cached across a switch by the compiler).
+thread_local Worker *self_worker = nullptr;
+thread_local Thread *current_thread = nullptr;
+// nesting depth of library code on this worker; SIGVTALRM only defers while it is positive
+thread_local volatile sig_atomic_t in_library = 0;
+// set by the timer handler when it fired inside the library; honoured by the outermost leave_library()
+thread_local volatile sig_atomic_t preempt_pending = 0;
+// SIGVTALRM is blocked on this kernel thread because timer_handler switched threads (see leave_library)
+thread_local volatile sig_atomic_t tick_masked = 0;
+// how this kernel thread holds sched_lock (SCHED_UNLOCKED, SCHED_SHARE or SCHED_WHOLE); passed on with the CPU at a
+// switch, to the thread switched to
+thread_local int sched_hold = SCHED_UNLOCKED;
 
 ///////////////// Helper Functions /////////////////
 
@@ -44,379 +167,2523 @@ int total_quantums = 0;
  * This function iterates through the thread array and deletes each thread pointer.
  */
 void destroy_threads() {
-    for (auto thread: thread_array) {
-        delete thread;
+    for (int tid = 0; tid < thread_array.get_capacity(); tid++) {
+        delete thread_array[tid];
     }
 }
 
+void quantum_update_func(int);
+bool work_available();
+bool io_pending();
+void poll_io();
+
 /**
- * @brief Blocks the signal specified in the signal_set.
+ * @brief True if uthreads run on more than one kernel thread; only then is anything locked.
  */
-void block_signal() {
-    if (sigprocmask(SIG_BLOCK, &signal_set, NULL) < 0) {
-        destroy_threads();
-        std::cerr << SYSTEM_ERR << SIGPROCMASK_ERR << std::endl;
-        exit(ERR_EXIT);
-    }
+bool multi_worker() {
+    return worker_count > 1;
 }
 
 /**
- * @brief Unblocks the signal specified in the signal_set.
+ * @brief True if READY threads wait on the workers' deques rather than in run_queue.
  */
-void unblock_signal() {
-    if (sigprocmask(SIG_UNBLOCK, &signal_set, NULL) < 0) {
-        destroy_threads();
-        std::cerr << SYSTEM_ERR << SIGPROCMASK_ERR << std::endl;
-        exit(ERR_CODE);
-    }
+bool use_deques() {
+    return SchedQueue::work_stealing && multi_worker();
 }
 
 /**
- * @brief Sets the timer for virtual time intervals.
+ * @brief True if this worker's next scheduling decision needs no more than its share of the scheduler lock:
+ * READY threads wait on the deques, the policy keeps no state (see RunQueue), and no thread sleeps or waits for
+ * I/O. Those are woken at the start of a quantum, which takes the whole lock; while any share is held, no thread
+ * can start to sleep or wait either.
+ *
+ * Under its share a worker then only touches its own fields, its running thread, and the threads it takes off
+ * the deques: the owner's push and take, and steals, run side by side on all the workers.
  */
-void set_timer() {
-    if (setitimer(ITIMER_VIRTUAL, &itimer, NULL) < 0) {
-        destroy_threads();
-        std::cerr << SYSTEM_ERR << SETITIMER_ERR << std::endl;
-        exit(ERR_CODE);
+bool switch_shared() {
+    return use_deques() && sleeping_threads.empty() && timed_sleepers.empty() && !io_pending();
+}
+
+void lock_scheduler() {
+    if (multi_worker()) {
+        sched_lock.lock();
+        sched_hold = SCHED_WHOLE;
     }
 }
 
 /**
- * @brief Checks if the given thread ID is valid.
- * 
- * @param tid Thread ID to check.
- * @return true if the thread ID is valid, false otherwise.
+ * @brief Takes the scheduler lock for a call that only gives up the CPU (a yield or a tick): this worker's share
+ * if that will do (switch_shared), else the whole lock; with try_only, only if the whole lock is free.
+ *
+ * @return false if try_only was given and the whole lock was busy.
  */
-bool valid_thread(int tid) {
-    return (tid >= 0 && tid < MAX_THREAD_NUM && thread_array[tid] != nullptr);
+bool lock_scheduler_for_switch(bool try_only) {
+    if (!multi_worker()) {
+        return true;
+    }
+    int index = self_worker->index;
+    if (sched_lock.try_lock_shared(index)) {
+        if (switch_shared()) {
+            sched_hold = SCHED_SHARE;
+            return true;
+        }
+        sched_lock.unlock_shared(index);
+    }
+    if (!try_only) {
+        sched_lock.lock();
+    } else if (!sched_lock.try_lock()) {
+        return false;
+    }
+    sched_hold = SCHED_WHOLE;
+    return true;
+}
+
+void unlock_scheduler() {
+    if (sched_hold == SCHED_SHARE) {
+        sched_lock.unlock_shared(self_worker->index);
+    } else if (sched_hold == SCHED_WHOLE) {
+        sched_lock.unlock();
+    }
+    sched_hold = SCHED_UNLOCKED;
 }
 
 /**
- * @brief Finds the minimal thread ID that is currently unused.
- * 
- * @return The minimal thread ID that is unused, or -1 if all IDs are in use.
+ * @brief Trades this worker's share of the scheduler lock for the whole lock, if the share is all it holds.
  */
-int find_minimal_tid() {
-    for (int i = 1; i < MAX_THREAD_NUM; i++) {
-        if (thread_array[i] == nullptr) {
-            return i;
-        }
+void lock_scheduler_whole() {
+    if (sched_hold == SCHED_SHARE) {
+        sched_lock.unlock_shared(self_worker->index);
+        lock_scheduler();
     }
-    return -1;
 }
 
 /**
- * @brief Removes the thread with the given ID from the ready list.
- * 
- * @param tid Thread ID to remove.
- * @return 1 if the thread was removed, -1 if the thread was not found.
+ * @brief Marks the running thread as inside the library, so a SIGVTALRM is deferred instead of switching.
+ *
+ * Replaces masking the signal with sigprocmask: it is a plain counter update, no system call. The outermost
+ * call also takes the whole scheduler lock, which is then held for as long as this worker is in the library; a
+ * call that only gives up the CPU may get by with the worker's share (see enter_scheduler).
  */
-int remove_thread_from_ready(int tid) {
-    for (auto thread = ready_threads.begin(); thread != ready_threads.end(); ++thread) {
-        if ((*thread)->get_tid() == tid) {
-            ready_threads.erase(thread);
-            return 1;
-        }
+void enter_library() {
+    if (in_library > 0) {
+        in_library = in_library + 1;
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        return;
+    }
+    // a preemption right before this store resumes us with in_library == 0 on whatever worker we landed on
+    in_library = 1;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    lock_scheduler();
+    // terminated by another worker while we were running user code
+    if (current_thread != nullptr && current_thread->get_state() == TERMINATED) {
+        quantum_update_func(0);
     }
-    return -1;
 }
 
 /**
- * @brief Updates the sleeping state of all threads.
- * 
- * Decrements the sleep counter for each thread. 
+ * @brief enter_library for uthread_yield: takes only this worker's share of the scheduler lock if that will do
+ * (see lock_scheduler_for_switch).
  */
-void update_sleeping() {
-    for (int i = 0; i < MAX_THREAD_NUM; i++) {
-        if (sleeping_threads[i] > 0) {
-            sleeping_threads[i]--;
-        }
-        if (sleeping_threads[i] == 0) {
-            State prev = thread_array[i]->get_state();
-            thread_array[i]->set_state(BLOCKED);
-            if (prev == SLEEPING) {
-                uthread_resume(i);
-            }
-        }
+void enter_scheduler() {
+    if (in_library > 0) {
+        enter_library();
+        return;
+    }
+    in_library = 1;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    lock_scheduler_for_switch(false);
+    if (current_thread != nullptr && current_thread->get_state() == TERMINATED) {
+        quantum_update_func(0);
     }
 }
 
 /**
- * @brief Moves to the next thread in the ready list.
+ * @brief Leaves the library; the outermost call performs a preemption the timer handler had to defer.
+ *
+ * Every context switch happens with in_library == 1, so a thread resumes here with the same depth it
+ * switched out with (on the worker it resumed on). If the switch was made by timer_handler, SIGVTALRM is still
+ * blocked, and this thread does not return through that handler's sigreturn: it is unblocked here, the only
+ * sigprocmask left, paid by a preemption that hands the CPU to a thread which gave it up itself.
  */
-void move_to_next_thread() {
-    // get the first ready thread
-    Thread *thread = ready_threads.front();
-    ready_threads.pop_front();
-
-    // set it to the current thread
-    thread->set_state(RUNNING);
-    thread->incrament_quantums();
-    current_thread = thread;
+void leave_library() {
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    if (in_library > 1) {
+        in_library = in_library - 1;
+        return;
+    }
+    while (preempt_pending) {
+        preempt_pending = 0;
+        quantum_update_func(QUANTUM_EXPIRED);
+    }
+    unlock_scheduler();
+    in_library = 0;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    if (tick_masked) {
+        tick_masked = 0;
+        sigprocmask(SIG_UNBLOCK, &timer_signal_set, NULL);
+    }
+    // a tick between the loop check and the store above was deferred, not handled
+    if (preempt_pending) {
+        enter_scheduler();
+        leave_library();
+    }
+}
 
-    unblock_signal();
-    siglongjmp(*(thread->get_env()), 1);
+uint64_t monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
 }
 
 /**
- * @brief handle err, print it, return err_code and unblock the signal.
+ * @brief base + count * unit, or UINT64_MAX if that does not fit: a deadline too far away to come is never.
  */
-int library_error_handler(std::string err){
-    std::cout << LIBRARY_ERR << err << std::endl;
-    unblock_signal();
-    return ERR_CODE;
+uint64_t saturating_ns(uint64_t base, uint64_t count, uint64_t unit) {
+    return count > (UINT64_MAX - base) / unit ? UINT64_MAX : base + count * unit;
 }
 
 /**
- * @brief checks if the state is neither block or sleep.
+ * @brief The time until the first timed sleeper is due (a real-time job's release, or the end of a
+ * uthread_sleep_for/uthread_sleep_until), if that is sooner than limit (nanoseconds).
  */
-bool not_block_or_sleep(State state){
-    return state != BLOCKED && state != SLEEPING && state != SLEEPING_AND_BLOCKED;
+uint64_t until_timed_wake(uint64_t limit) {
+    if (timed_sleepers.empty()) {
+        return limit;
+    }
+    uint64_t now = monotonic_ns();
+    uint64_t release = timed_sleepers.next_wake();
+    if (release <= now) {
+        return 0;
+    }
+    return std::min(limit, release - now);
 }
 
 /**
- * @brief Updates the quantum timer and schedules the next thread.
- * 
- * Blocks signals, updates the sleep state of threads, and increments the total quantum count.
- * 
- * @param unused Unused parameter to match the expected function signature for signal handlers.
+ * @brief Arms worker's quantum timer to tick first in first nanoseconds and then every quantum; 0 disarms it.
+ *
+ * A single worker keeps the process-wide virtual timer; with several, each one has a timer on its own thread's CPU
+ * clock that signals only itself. Both deliver SIGVTALRM.
  */
-void quantum_update_func(int) {
-    block_signal();
-    update_sleeping();
-    total_quantums++;
-
-    if (ready_threads.empty()) {
-        current_thread->incrament_quantums();
-        unblock_signal();
-        return;
-    } else if (current_thread == nullptr) {
-        set_timer();
-        move_to_next_thread();
-    } else if (sigsetjmp(*(current_thread->get_env()), 1) == 0) {
-        if (not_block_or_sleep(current_thread->get_state())) {
-            current_thread->set_state(READY);
-            ready_threads.push_back(current_thread);
-        }
-        set_timer();
-        move_to_next_thread();
+void arm_timer(Worker *worker, uint64_t first) {
+    int ret;
+    if (multi_worker()) {
+        struct itimerspec spec = quantum_spec;
+        spec.it_value.tv_sec = first / NSEC_PER_SEC;
+        spec.it_value.tv_nsec = first % NSEC_PER_SEC;
+        ret = timer_settime(worker->timer, 0, &spec, NULL);
+    } else {
+        struct itimerval value = itimer;
+        value.it_value.tv_sec = first / NSEC_PER_SEC;
+        value.it_value.tv_usec = first % NSEC_PER_SEC / NSEC_PER_USEC;
+        ret = setitimer(ITIMER_VIRTUAL, &value, NULL);
+    }
+    if (ret < 0) {
+        destroy_threads();
+        std::cerr << SYSTEM_ERR << SETITIMER_ERR << std::endl;
+        exit(ERR_CODE);
     }
 }
 
-///////////////// library api /////////////////
-
-int uthread_init(int quantum_usecs) {
-    if (quantum_usecs <= 0) {
-        std::cout << LIBRARY_ERR << INVALID_QUANTUM_ERR << std::endl;
-        return ERR_CODE;
-    }
-    sig_act.sa_handler = &quantum_update_func;
-    if (sigaction(SIGVTALRM, &sig_act, NULL) < 0) {
-        std::cerr << SYSTEM_ERR << SIGACTION_ERR << std::endl;
-        exit(ERR_EXIT);
+/**
+ * @brief The time on the clock worker's quantum timer runs on (nanoseconds): the process's user time for a single
+ * worker, as the virtual timer counts it, else the CPU time of the worker's kernel thread.
+ */
+uint64_t worker_cpu_ns(Worker *worker) {
+    if (!multi_worker()) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return (uint64_t) usage.ru_utime.tv_sec * NSEC_PER_SEC + (uint64_t) usage.ru_utime.tv_usec * NSEC_PER_USEC;
     }
-    // set signal set
-    sigemptyset(&signal_set);
-    sigaddset(&signal_set, SIGVTALRM);
-    // set timer
-    itimer = {{quantum_usecs / TIME_SET, quantum_usecs % TIME_SET},
-              {quantum_usecs / TIME_SET, quantum_usecs % TIME_SET}};
-    // set main thread
-    Thread *main_thread = new Thread();
-    thread_array[0] = main_thread;
-    current_thread = main_thread;
-    // init sleeping thread
-    for (int i = 0; i < MAX_THREAD_NUM; ++i) {
-    sleeping_threads[i] = -1;
+    struct timespec now;
+    clock_gettime(worker->cpu_clock, &now);
+    return (uint64_t) now.tv_sec * NSEC_PER_SEC + now.tv_nsec;
+}
+
+/**
+ * @brief The quantums that would have started on worker since it went tickless, had its timer kept ticking; 0 if
+ * it ticks.
+ */
+int skipped_quantums(Worker *worker) {
+    if (!worker->tickless) {
+        return 0;
     }
-    // quantum update
-    main_thread->incrament_quantums();
-    total_quantums++;
-    set_timer();
-    return EXIT_SUCCESS;
+    return (int) ((worker_cpu_ns(worker) - worker->tickless_since) / quantum_ns);
 }
 
 /**
- * @brief Creates a new thread, whose entry point is the function entry_point with the signature
- * void entry_point(void).
- *
- * The thread is added to the end of the READY threads list.
- * The uthread_spawn function should fail if it would cause the number of concurrent threads to exceed the
- * limit (MAX_THREAD_NUM).
- * Each thread should be allocated with a stack of size STACK_SIZE bytes.
- * It is an error to call this function with a null entry_point.
+ * @brief Counts the quantums this tickless worker skipped so far as if they had started: in total_quantums, for
+ * the policy and for the running thread.
  *
- * @return On success, return the ID of the created thread. On failure, return -1.
-*/
-int uthread_spawn(thread_entry_point entry_point){
-    block_signal();
-    if (entry_point == nullptr) {
-        return library_error_handler(NO_ENTRY_POINT_ERR);
+ * @return How far the running thread is into the quantum it would be in now (nanoseconds).
+ */
+uint64_t catch_up_quantums(Worker *worker) {
+    uint64_t ran = worker_cpu_ns(worker) - worker->tickless_since;
+    int skipped = (int) (ran / quantum_ns);
+    worker->tickless_since += (uint64_t) skipped * quantum_ns;
+    // nullptr if it just terminated itself
+    if (current_thread != nullptr) {
+        current_thread->set_quantums(current_thread->get_quantums() + skipped);
     }
-    int tid = find_minimal_tid();
-    if (tid == -1) {
-        return library_error_handler(NO_FREE_TID_ERR);
+    for (int i = 0; i < skipped; i++) {
+        run_queue.new_quantum(++total_quantums);
     }
-    Thread *new_thread = new Thread(tid, entry_point);
-    thread_array[tid] = new_thread;
-    ready_threads.push_back(new_thread);
-    unblock_signal();
-    return tid;
+    return ran - (uint64_t) skipped * quantum_ns;
 }
 
 /**
- * @brief Terminates the thread with ID tid and deletes it from all relevant control structures.
- *
- * All the resources allocated by the library for this thread should be released. If no thread with ID tid exists it
- * is considered an error. Terminating the main thread (tid == 0) will result in the termination of the entire
- * process using exit(0) (after releasing the assigned library memory).
+ * @brief True if thread, running on worker, has nothing to share the CPU with that needs its quantum timer: no
+ * READY thread, no thread asleep for a number of quantums (they count on the ticks), no I/O to poll at the ticks,
+ * and a whole quantum to run for. Timed sleepers do not count, wake_timer wakes them.
+ */
+bool alone(Worker *worker, Thread *thread) {
+    return TICKLESS && thread != worker->idle && worker->run_next == nullptr && !work_available() &&
+           sleeping_threads.empty() && !io_pending() && run_queue.slice(thread) == 0;
+}
+
+/**
+ * @brief Disarms worker's quantum timer: its running thread used up a quantum alone, and every tick from now on
+ * would only start another quantum for the same thread.
  *
- * @return The function returns 0 if the thread was successfully terminated and -1 otherwise. If a thread terminates
- * itself or the main thread is terminated, the function does not return.
-*/
-int uthread_terminate(int tid){
-    block_signal();
-    if(!valid_thread(tid)){
-        return library_error_handler(INVALID_THREAD_ERR);
-    }
-    // terminate the main thread
-    if(tid == MAIN_THREAD) {
-        destroy_threads();
-        exit(EXIT_SUCCESS);
-    }
-    // terminate itself
-    if (tid == current_thread->get_tid()) {
-        delete thread_array[tid];
-        thread_array[tid] = nullptr;
-        current_thread = nullptr;
-        sleeping_threads[tid] = -1;
-        quantum_update_func(0);
+ * The quantums still count, lazily: the ones that would have started since are worked out from the worker's CPU
+ * clock when they are asked for (skipped_quantums), and counted for good when the timer is armed again.
+ */
+void go_tickless(Worker *worker) {
+    arm_timer(worker, 0);
+    worker->tickless = true;
+    worker->tickless_since = worker_cpu_ns(worker);
+}
+
+/**
+ * @brief Arms this tickless worker's quantum timer again, now that its running thread has competition: first for
+ * the rest of the quantum it would be in had the timer ticked all along. Does nothing if the worker ticks.
+ */
+void end_tickless(Worker *worker) {
+    if (!worker->tickless) {
+        return;
     }
-    else {
-        remove_thread_from_ready(tid);
-        delete thread_array[tid];
-        thread_array[tid] = nullptr;
+    uint64_t into = catch_up_quantums(worker);
+    worker->tickless = false;
+    // a zero expiry would disarm the timer
+    arm_timer(worker, std::max(quantum_ns - into, (uint64_t) NSEC_PER_USEC));
+}
+
+/**
+ * @brief Makes another worker enter the scheduler soon, to switch out the thread it runs (blocked or terminated from
+ * here). Its next tick does that; a tickless worker has none coming, so its timer is armed to tick at once.
+ */
+void kick_worker(Worker *worker) {
+    if (worker->tickless) {
+        arm_timer(worker, NSEC_PER_USEC);
     }
-    unblock_signal();
-    return EXIT_SUCCESS;
 }
 
 /**
- * @brief Blocks the thread with ID tid. The thread may be resumed later using uthread_resume.
- *
- * If no thread with ID tid exists it is considered as an error. In addition, it is an error to try blocking the
- * main thread (tid == 0). If a thread blocks itself, a scheduling decision should be made. Blocking a thread in
- * BLOCKED state has no effect and is not considered an error.
+ * @brief Restarts this worker's quantum timer for next, the thread it is about to run.
  *
- * @return On success, return 0. On failure, return -1.
-*/
-int uthread_block(int tid){
-    block_signal();
-    if(tid == 0 || !valid_thread(tid)){
-        return library_error_handler(INVALID_THREAD_ERR);
-    }
-    State thread_state = thread_array[tid]->get_state();
-    if(thread_state != BLOCKED && thread_state != SLEEPING_AND_BLOCKED) {
-        if (thread_state == SLEEPING) {
-            thread_array[tid]->set_state(SLEEPING_AND_BLOCKED);
-        } else {
-            thread_array[tid]->set_state(BLOCKED);
-        }
+ * The first tick comes early if the policy cuts next's quantum short (the rest of a real-time job's budget); from
+ * then on it ticks every quantum (see arm_timer). Timed sleepers have wake_timer instead: a CPU clock is only
+ * sampled at the kernel's own ticks, milliseconds apart. If the worker was tickless, the thread it ran gets the
+ * quantums it skipped first.
+ */
+void set_timer(Thread *next) {
+    Worker *worker = self_worker;
+    if (worker->tickless) {
+        catch_up_quantums(worker);
+        worker->tickless = false;
     }
-    if (tid == current_thread->get_tid()) {
-        quantum_update_func(0);
+    uint64_t first = quantum_ns;
+    uint64_t slice = run_queue.slice(next);
+    if (slice != 0 && slice < first) {
+        // a zero expiry would disarm the timer
+        first = std::max(slice, (uint64_t) NSEC_PER_USEC);
     }
-    remove_thread_from_ready(tid);
-    unblock_signal();
-    return 0;
+    arm_timer(worker, first);
 }
 
 /**
- * @brief Resumes a blocked thread with ID tid and moves it to the READY `state.`
- *
- * Resuming a thread in a RUNNING or READY state has no effect and is not considered as an error. If no thread with
- * ID tid exists it is considered an error.
+ * @brief set_timer for a thread that keeps the CPU in a new quantum, only if its next tick may have to come
+ * early; otherwise the timer ticks on undisturbed, without a system call.
  *
- * @return On success, return 0. On failure, return -1.
-*/
-int uthread_resume(int tid){
-    block_signal();
-    if(!valid_thread(tid)){
-        return library_error_handler(INVALID_THREAD_ERR);
+ * A thread that used up its quantum (expired) alone goes tickless (go_tickless) until it has competition. A tick
+ * that still comes to a tickless worker (wake_handler arms its timer) disarms the timer again.
+ */
+void reset_timer(Thread *thread, bool expired) {
+    Worker *worker = self_worker;
+    if (run_queue.slice(thread) != 0) {
+        set_timer(thread);
+        return;
     }
-    State thread_state = thread_array[tid]->get_state();
-    if(thread_state == SLEEPING_AND_BLOCKED){
-        thread_array[tid]->set_state(SLEEPING);
-    } 
-    if(thread_state == BLOCKED){
-        thread_array[tid]->set_state(READY);
-        ready_threads.push_back(thread_array[tid]);
+    bool lone = alone(worker, thread);
+    if (worker->tickless && !lone) {
+        end_tickless(worker);
+    } else if (lone && expired) {
+        go_tickless(worker);
     }
-    unblock_signal();
-    return EXIT_SUCCESS;
 }
 
 /**
- * @brief Blocks the RUNNING thread for num_quantums quantums.
- *
- * Immediately after the RUNNING thread transitions to the BLOCKED state a scheduling decision should be made.
- * After the sleeping time is over, the thread should go back to the end of the READY queue.
- * If the thread which was just RUNNING should also be added to the READY queue, or if multiple threads wake up 
- * at the same time, the order in which they're added to the end of the READY queue doesn't matter.
- * The number of quantums refers to the number of times a new quantum starts, regardless of the reason. Specifically,
- * the quantum of the thread which has made the call to uthread_sleep isn’t counted.
- * It is considered an error if the main thread (tid == 0) calls this function.
+ * @brief Arms wake_timer for the first of timed_sleepers, unless it is armed for that time already; disarms it if
+ * there are none.
  *
- * @return On success, return 0. On failure, return -1.
-*/
-int uthread_sleep(int num_quantums) {
-    block_signal();
-    if (current_thread == thread_array[0]) {
-        return library_error_handler(MAIN_SLEEP_ERR);
+ * Its signal makes worker 0 start a new quantum (see wake_handler), which wakes the sleepers that are due. A sleeper
+ * taken out early (terminated) leaves the timer as it is, for at most one tick too many.
+ */
+void arm_wake_timer() {
+    uint64_t at = timed_sleepers.empty() ? 0 : timed_sleepers.next_wake();
+    if (at == wake_timer_at || (at == 0 && wake_timer_at < monotonic_ns())) {
+        wake_timer_at = at;
+        return;
     }
-    current_thread->set_state(SLEEPING);
-    sleeping_threads[current_thread->get_tid()] = num_quantums;
-    quantum_update_func(0);
-    unblock_signal();
-    return EXIT_SUCCESS;
+    struct itimerspec spec = {{0, 0}, {(time_t) (at / NSEC_PER_SEC), (long) (at % NSEC_PER_SEC)}};
+    if (timer_settime(wake_timer, TIMER_ABSTIME, &spec, NULL) < 0) {
+        destroy_threads();
+        std::cerr << SYSTEM_ERR << SETITIMER_ERR << std::endl;
+        exit(ERR_CODE);
+    }
+    wake_timer_at = at;
 }
 
 /**
- * @brief Returns the thread ID of the calling thread.
+ * @brief Charges the running thread with the time since the last charge (or since it was switched in).
  *
- * @return The ID of the calling thread.
-*/
-int uthread_get_tid(){
-    return current_thread->get_tid();
+ * This is wall-clock time on the monotonic clock, read through the vDSO: a per-thread CPU clock would be a system
+ * call at every switch. It only differs from CPU time while the kernel runs something else on this worker's core.
+ */
+void charge_running(Worker *worker) {
+    uint64_t now = monotonic_ns();
+    if (current_thread != nullptr) {
+        current_thread->add_runtime(now - worker->run_start);
+    }
+    worker->run_start = now;
 }
 
 /**
- * @brief Returns the total number of quantums since the library was initialized, including the current quantum.
- *
- * Right after the call to uthread_init, the value should be 1.
- * Each time a new quantum starts, regardless of the reason, this number should be increased by 1.
- *
- * @return The total number of quantums.
-*/
-int uthread_get_total_quantums(){
-    return total_quantums;
+ * @brief Checks if the given thread ID is valid.
+ * 
+ * @param tid Thread ID to check.
+ * @return true if the thread ID is valid, false otherwise.
+ */
+bool valid_thread(int tid) {
+    return (tid >= 0 && tid < thread_array.get_capacity() && thread_array[tid] != nullptr);
 }
 
 /**
- * @brief Returns the number of quantums the thread with ID tid was in RUNNING state.
- *
- * On the first time a thread runs, the function should return 1. Every additional quantum that the thread starts should
- * increase this value by 1 (so if the thread with ID tid is in RUNNING state when this function is called, include
- * also the current quantum). If no thread with ID tid exists it is considered an error.
- *
- * @return On success, return the number of quantums of the thread with ID tid. On failure, return -1.
-*/
-int uthread_get_quantums(int tid){
-    if(valid_thread(tid)){
-        return thread_array[tid]->get_quantums();
-    }
+ * @brief Finds the minimal thread ID that is currently unused and marks it as taken.
+ * 
+ * @return The minimal thread ID that is unused, or -1 if all IDs are in use.
+ */
+int find_minimal_tid() {
+    return free_tids.acquire();
+}
 
-    std::cout << LIBRARY_ERR <<INVALID_THREAD_ERR << std::endl;
-    return ERR_CODE;
+/**
+ * @brief Removes the thread with the given ID from the run queue, or from the wait queue it is parked on.
+ * 
+ * @param tid Thread ID to remove.
+ * @return 1 if the thread was removed, -1 if the thread was not found.
+ */
+int remove_thread_from_ready(int tid) {
+    Thread *thread = thread_array[tid];
+    return run_queue.erase(thread) || ReadyQueue::remove(thread) ? 1 : -1;
+}
+
+/**
+ * @brief Wakes one idle worker, if there is any, after work was queued.
+ */
+void wake_idle_worker() {
+    if (idle_workers > (io_polling ? 1 : 0)) {
+        work_seq.fetch_add(1, std::memory_order_relaxed);
+        syscall(SYS_futex, (int *) &work_seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    } else if (io_polling) {
+        io_reactor.notify();
+    }
+}
+
+/**
+ * @brief Frees a terminated thread and its stack.
+ */
+void free_thread(Thread *thread) {
+    stack_lock.lock();
+    stack_pool.release(thread->get_stack(), thread->get_stack_size());
+    stack_lock.unlock();
+    delete thread;
+}
+
+/**
+ * @brief Deals with a thread just taken off a deque or out of run_next. Neither can unlink a thread from the
+ * middle, so blocking or terminating a queued thread only changes its state and leaves the entry for whoever
+ * takes it.
+ *
+ * A thread may have several entries (see uthread_switch_to): whichever claims it READY runs it (Thread::claim),
+ * the others find it in some other state and drop it. A terminated thread is freed with its last entry, the CPU
+ * it was running on counting as one (see uthread_terminate).
+ *
+ * @return true if the thread is READY to run, false if it was dropped (blocked: uthread_resume queues it again)
+ * or freed (terminated).
+ */
+bool settle_queued(Thread *thread) {
+    // only the whole lock terminates a thread; once our entry is dropped, another worker may free it
+    if (thread->get_state() == TERMINATED) {
+        if (thread->drop_entry() == 0) {
+            free_thread(thread);
+        }
+        return false;
+    }
+    thread->drop_entry();
+    return thread->get_state() == READY;
+}
+
+/**
+ * @brief Takes the first READY thread off deque and claims it, settling the stale entries in front of it.
+ */
+Thread *take_ready(WorkStealingDeque &deque) {
+    Thread *thread;
+    while ((thread = deque.steal()) != nullptr) {
+        if (settle_queued(thread) && thread->claim()) {
+            return thread;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Pushes thread on worker's own deque. If the deque is full of stale entries (threads terminated while
+ * queued, whose IDs were already reused, or duplicates left by uthread_switch_to), they are settled first; the
+ * live entries keep their order.
+ */
+void push_queued(Worker *worker, Thread *thread) {
+    WorkStealingDeque &deque = worker->deque;
+    if (deque.size() >= deque.capacity()) {
+        for (long n = deque.size(); n > 0; n--) {
+            Thread *entry = deque.steal();
+            if (entry == nullptr) {
+                break;
+            }
+            // a READY thread with another entry left (after uthread_switch_to) only keeps that one; if another
+            // worker takes that one meanwhile, an entry too many stays behind, stale
+            if (settle_queued(entry) && !entry->is_queued()) {
+                entry->add_entry();
+                deque.push(entry);
+            }
+        }
+    }
+    thread->add_entry();
+    deque.push(thread);
+}
+
+/**
+ * @brief Queues a READY thread: in the run queue, or at the end of this worker's deque.
+ */
+void make_ready(Thread *thread) {
+    thread->set_state(READY);
+    if (use_deques()) {
+        push_queued(self_worker, thread);
+    } else {
+        run_queue.push(thread);
+    }
+    wake_idle_worker();
+    // the running thread is no longer alone: its timer must tick to preempt it
+    end_tickless(self_worker);
+}
+
+/**
+ * @brief Moves worker's run_next, if any, back to the run queue.
+ */
+void flush_run_next(Worker *worker) {
+    Thread *thread = worker->run_next;
+    if (thread != nullptr) {
+        worker->run_next = nullptr;
+        // claimed first: it may have a deque entry too, which another worker could take meanwhile
+        if (settle_queued(thread) && thread->claim()) {
+            make_ready(thread);
+        }
+    }
+}
+
+/**
+ * @brief Picks the next thread for worker: its run_next, else the policy's pick from the run queue. On the deques:
+ * the oldest of its own, else one stolen from another worker.
+ *
+ * @return The thread, off its queue, or nullptr if nothing is READY anywhere.
+ */
+Thread *pick_next(Worker *worker) {
+    Thread *thread = worker->run_next;
+    if (thread != nullptr) {
+        worker->run_next = nullptr;
+        if (settle_queued(thread) && thread->claim()) {
+            return thread;
+        }
+    }
+    if (!use_deques()) {
+        return run_queue.pop();
+    }
+    thread = take_ready(worker->deque);
+    for (int i = 1; thread == nullptr && i < worker_count; i++) {
+        thread = take_ready(workers[(worker->index + i) % worker_count].deque);
+        if (thread != nullptr) {
+            worker->steals++;
+        }
+    }
+    return thread;
+}
+
+/**
+ * @brief True if some worker seems to have a READY thread. Safe without the scheduler lock.
+ */
+bool work_available() {
+    if (!use_deques()) {
+        return !run_queue.empty();
+    }
+    for (int i = 0; i < worker_count; i++) {
+        if (!workers[i].deque.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Steals the oldest entry of another worker's deque, without the scheduler lock and without looking at
+ * the thread: it is settled once the lock is taken (see wait_for_work).
+ *
+ * @return The entry, or nullptr if every other deque is empty.
+ */
+Thread *steal_work(Worker *worker) {
+    if (!use_deques()) {
+        return nullptr;
+    }
+    for (int i = 1; i < worker_count; i++) {
+        Thread *thread = workers[(worker->index + i) % worker_count].deque.steal();
+        if (thread != nullptr) {
+            return thread;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Lets a thread that is no longer blocked or asleep run again: the end of uthread_resume. wake_sleepers
+ * calls it directly, since it may run in the timer handler, on a stack too short for a nested library call.
+ */
+void unblock(Thread *thread) {
+    if (thread->get_worker() >= 0) {
+        // blocked from another worker, which has not switched it out yet: just let it go on
+        thread->set_state(RUNNING);
+    } else if (thread->is_queued()) {
+        // blocked while on a deque, and its entry is still there
+        thread->set_state(READY);
+    } else {
+        make_ready(thread);
+    }
+}
+
+/**
+ * @brief Wakes up every thread of queue whose sleep ends by time now.
+ * 
+ * Only the expired threads are touched; a woken thread goes back to the READY queue unless it was also blocked.
+ */
+void wake_sleepers(SleepQueue &queue, uint64_t now) {
+    Thread *thread;
+    while ((thread = queue.pop_expired(now)) != nullptr) {
+        TRACE_EVENT(TRACE_WAKE, thread->get_tid(), 0);
+        if (thread->get_state() == SLEEPING) {
+            unblock(thread);
+        } else {
+            thread->set_state(BLOCKED);
+        }
+    }
+}
+
+/**
+ * @brief Wakes up the threads whose sleep ends by the current quantum, and the timed sleepers that are due by now
+ * (re-arming wake_timer for the next one).
+ */
+void update_sleeping() {
+    wake_sleepers(sleeping_threads, total_quantums);
+    if (!timed_sleepers.empty()) {
+        wake_sleepers(timed_sleepers, monotonic_ns());
+        arm_wake_timer();
+    }
+}
+
+/**
+ * @brief Completes this worker's switch, on the stack of the thread it switched to: queues the thread it switched
+ * away from if that can run on (Worker::requeue), now that its context is saved and another worker may take it at
+ * once; or, if it terminated, drops the entry its CPU held, freeing it unless a deque still holds one.
+ */
+void finish_switch() {
+    Worker *worker = self_worker;
+    Thread *thread = worker->requeue;
+    if (thread != nullptr) {
+        worker->requeue = nullptr;
+        make_ready(thread);
+    }
+    thread = worker->dead;
+    if (thread != nullptr) {
+        worker->dead = nullptr;
+        thread->set_worker(-1);
+        settle_queued(thread);
+    }
+}
+
+/**
+ * @brief Switches this worker from prev to next.
+ *
+ * Returns when prev is scheduled again, possibly on another worker. prev == nullptr means the running thread
+ * is gone and its context is not saved. The switch runs inside the library (in_library == 1) and the scheduler
+ * lock is handed over with it, the whole lock or this worker's share, whichever is held: the resumed thread
+ * releases it on its own way out (timer_handler, API exit or thread_start), after finish_switch. A thread that
+ * switched out with the whole lock and comes back with a share trades it for the whole lock again.
+ *
+ * No other worker can pick prev before its context is saved: under the whole lock nobody else schedules, and
+ * under a share prev is only queued by finish_switch.
+ *
+ * @param prev The thread that was running until now.
+ * @param next The thread to run, already unlinked from any queue.
+ */
+void move_to_next_thread(Thread *prev, Thread *next) {
+    Worker *worker = self_worker;
+    int hold = sched_hold;
+    // a terminated thread switched away from is the worker's dead one
+    TRACE_EVENT(TRACE_SWITCH, next->get_tid(), prev != nullptr ? prev->get_tid() : worker->dead->get_tid());
+    next->set_state(RUNNING);
+    next->incrament_quantums();
+    next->set_worker(worker->index);
+    if (prev != nullptr) {
+        prev->set_worker(-1);
+    }
+    current_thread = next;
+    if (next->is_preempted() && !tick_masked) {
+        // it finishes timer_handler first, where a tick must not land a second frame on its stack
+        tick_masked = 1;
+        sigprocmask(SIG_BLOCK, &timer_signal_set, NULL);
+    }
+
+#ifdef UTHREADS_ASM_SWITCH
+    context_switch(prev != nullptr ? prev->get_context() : &worker->dead_context, next->get_context());
+#else
+    if (prev == nullptr || sigsetjmp(*(prev->get_env()), 1) == 0) {
+        siglongjmp(*(next->get_env()), 1);
+    }
+#endif
+    finish_switch();
+    if (hold == SCHED_WHOLE) {
+        lock_scheduler_whole();
+    }
+}
+
+/**
+ * @brief First function run by every spawned thread, on the thread's own stack.
+ *
+ * Runs the entry point and terminates the thread if the entry point ever returns.
+ */
+void thread_start() {
+    finish_switch();
+    leave_library();
+    current_thread->get_entry()();
+    uthread_terminate(uthread_get_tid());
+}
+
+/**
+ * @brief handle err, print it, return err_code and leave the library.
+ */
+int library_error_handler(std::string err){
+    std::cout << LIBRARY_ERR << err << std::endl;
+    leave_library();
+    return ERR_CODE;
+}
+
+/**
+ * @brief checks if the state is neither block, sleep nor waiting on a mutex or condition variable.
+ */
+bool not_block_or_sleep(State state){
+    return state != BLOCKED && state != SLEEPING && state != SLEEPING_AND_BLOCKED && state != WAITING &&
+           state != WAITING_AND_BLOCKED;
+}
+
+/**
+ * @brief Puts the running thread into state, SLEEPING or WAITING, as it is about to give up the CPU.
+ *
+ * uthread_block from another worker only marks a running thread BLOCKED, so the thread may be BLOCKED already when
+ * it gets here. It then becomes SLEEPING_AND_BLOCKED or WAITING_AND_BLOCKED instead: the block outlasts the sleep
+ * or the wait, and the thread needs uthread_resume afterwards.
+ */
+void set_waiting_state(Thread *thread, State state) {
+    if (thread->get_state() == BLOCKED) {
+        state = state == SLEEPING ? SLEEPING_AND_BLOCKED : WAITING_AND_BLOCKED;
+    }
+    thread->set_state(state);
+}
+
+/**
+ * @brief Starts a new quantum: counts it, tells the policy and wakes up the threads whose sleep is over.
+ */
+void start_quantum() {
+    run_queue.new_quantum(++total_quantums);
+    update_sleeping();
+}
+
+/**
+ * @brief Updates the quantum timer and schedules the next thread on this worker.
+ * 
+ * Starts a new quantum and lets the policy pick the next thread. The running thread keeps the CPU if nothing else
+ * is READY (or if the policy picks it again); if it cannot run either, the worker goes idle. Must be called inside
+ * the library (in_library == 1), with the whole scheduler lock or, if switch_shared, with the worker's share.
+ * 
+ * @param expired QUANTUM_EXPIRED if the running thread is preempted at the end of its quantum, 0 if it gives up
+ * the CPU itself.
+ */
+void quantum_update_func(int expired) {
+    Worker *worker = self_worker;
+    charge_running(worker);
+    if (worker->tickless && (expired == QUANTUM_EXPIRED || !sleeping_threads.empty())) {
+        // the sleepers count down the quantums another worker started, and the ones this one skipped; a tick that
+        // comes all the same (see wake_handler) starts the quantum after the skipped ones
+        catch_up_quantums(worker);
+    }
+    start_quantum();
+    // I/O is polled when the READY threads run out, and at every tick so it cannot starve behind them
+    if (io_pending() && (expired == QUANTUM_EXPIRED || !work_available())) {
+        poll_io();
+    }
+
+    Thread *prev = current_thread;
+    if (prev != nullptr && prev->get_state() == TERMINATED) {
+        // uthread_terminate from another worker left the stack and the object to us
+        worker->dead = prev;
+        prev = nullptr;
+    }
+    if (prev != nullptr && prev != worker->idle) {
+        run_queue.stopped(prev, expired == QUANTUM_EXPIRED);
+    }
+    bool runnable = prev != nullptr && prev != worker->idle && not_block_or_sleep(prev->get_state());
+    if (runnable) {
+        // only a thread that gives up the CPU hands it to the thread it woke; a preempted one does not jump the queue
+        flush_run_next(worker);
+        if (!use_deques()) {
+            // the policy weighs the running thread against the READY ones, and may well pick it again
+            prev->set_state(READY);
+            run_queue.push(prev);
+        }
+    }
+    Thread *next = pick_next(worker);
+    if (next != nullptr && next == prev) {
+        prev->set_state(RUNNING);
+        prev->incrament_quantums();
+        reset_timer(prev, expired == QUANTUM_EXPIRED);
+        return;
+    }
+    if (next == nullptr) {
+        if (runnable) {
+            prev->incrament_quantums();
+            reset_timer(prev, expired == QUANTUM_EXPIRED);
+            return;
+        }
+        if (prev == worker->idle) {
+            return;
+        }
+        next = worker->idle;
+    }
+    if (runnable) {
+        if (use_deques()) {
+            // under a share another worker could take it off the deque before its context is saved
+            worker->requeue = prev;
+        } else {
+            wake_idle_worker();
+        }
+    }
+    set_timer(next);
+    move_to_next_thread(prev, next);
+}
+
+/**
+ * @brief Counts the whole quantums an idle worker spent waiting for sleepers since since (CLOCK_MONOTONIC
+ * nanoseconds) as if they had started, waking the threads asleep in quantums that came due; if the wait timed_out,
+ * the last one is left to the quantum worker_idle starts next.
+ */
+void count_idle_quantums(uint64_t since, bool timed_out) {
+    uint64_t passed = (monotonic_ns() - since) / quantum_ns;
+    if (timed_out && passed > 0) {
+        passed--;
+    }
+    for (uint64_t i = 0; i < passed; i++) {
+        start_quantum();
+    }
+}
+
+/**
+ * @brief Sleeps until some worker queues work, or until the first thread asleep in quantums is due (nobody else
+ * may be ticking), or until the first timed sleeper is due if that is sooner. Called by the idle thread with the
+ * scheduler lock held, which it drops while waiting.
+ *
+ * The wait is in wall-clock time, and the worker uses no CPU meanwhile: its quantum timer stands still with it,
+ * so an idle quantum is a quantum of real time. The quantums that went by are counted when the wait ends
+ * (count_idle_quantums), so an idle uthread_sleep costs one wakeup however long it is. A single worker has nobody to
+ * queue work but the sleepers and I/O, and waits in ppoll, on the reactor if threads are parked on
+ * file descriptors and on the file I/O completions if reads or writes are in flight; a signal also ends the wait.
+ * With several workers, one idle worker waits on those and the others on a futex.
+ *
+ * With several workers it first tries to steal from the others, still without the lock, and moves what it stole
+ * to its own deque. The lock is not needed to steal: the thread is only run (or dropped) after the lock is taken
+ * back, by then its context is saved and its state stable. Returning true means there may be work to pick up.
+ *
+ * @return false if the wait timed out.
+ */
+bool wait_for_work() {
+    bool timed = !sleeping_threads.empty() || !timed_sleepers.empty();
+    uint64_t limit = UINT64_MAX;
+    if (!sleeping_threads.empty()) {
+        // the quantums left until the first of them is due
+        uint64_t due = sleeping_threads.next_wake();
+        uint64_t left = due - std::min(due, (uint64_t) total_quantums);
+        limit = quantum_ns * std::min(left, UINT64_MAX / quantum_ns);
+    }
+    uint64_t timeout = until_timed_wake(limit);
+    uint64_t since = monotonic_ns();
+    struct timespec quantum = {(time_t) (timeout / NSEC_PER_SEC), (long) (timeout % NSEC_PER_SEC)};
+    // the reactor, and the file I/O completions if requests are in flight
+    struct pollfd sources[2] = {{io_reactor.fd(), POLLIN, 0}, {file_io.fd(), POLLIN, 0}};
+    nfds_t source_count = 0;
+    if (!multi_worker()) {
+        // a tick deferred meanwhile (the timer may fire on the way in) is served by the next quantum
+        if (io_reactor.active()) {
+            source_count++;
+        } else {
+            sources[0] = sources[1];
+        }
+        source_count += file_io.active() ? 1 : 0;
+        int ret = ppoll(source_count > 0 ? sources : NULL, source_count, timed ? &quantum : NULL, NULL);
+        if (timed) {
+            count_idle_quantums(since, ret == 0);
+        }
+        if (ret > 0) {
+            poll_io();
+        }
+        return ret != 0;
+    }
+    int seq = work_seq.load(std::memory_order_relaxed);
+    // one idle worker at a time waits in the reactor (and for file I/O), the others on work_seq; the reactor is
+    // opened for its eventfd even if only file I/O is pending, so that wake_idle_worker can interrupt the wait
+    bool poller = io_pending() && !io_polling && io_reactor.open();
+    io_polling = io_polling || poller;
+    sources[0].fd = io_reactor.fd();
+    source_count = file_io.active() ? 2 : 1;
+    idle_workers++;
+    unlock_scheduler();
+    // anything queued before idle_workers++ is visible here; anything queued after it bumps work_seq (or, for the
+    // poller, notifies the reactor)
+    Thread *stolen = steal_work(self_worker);
+    bool timed_out = false;
+    if (stolen == nullptr && poller) {
+        timed_out = ppoll(sources, source_count, timed ? &quantum : NULL, NULL) == 0;
+    } else if (stolen == nullptr) {
+        long ret = syscall(SYS_futex, (int *) &work_seq, FUTEX_WAIT_PRIVATE, seq, timed ? &quantum : NULL, NULL, 0);
+        timed_out = ret < 0 && errno == ETIMEDOUT;
+    }
+    lock_scheduler();
+    idle_workers--;
+    if (timed) {
+        count_idle_quantums(since, timed_out);
+    }
+    if (poller) {
+        io_polling = false;
+        poll_io();
+    }
+    if (stolen != nullptr) {
+        self_worker->steals++;
+        // its entry moves here: push_queued adds one of its own
+        if (settle_queued(stolen)) {
+            push_queued(self_worker, stolen);
+        }
+    }
+    return !timed_out;
+}
+
+/**
+ * @brief Body of every worker's idle thread: runs whatever becomes READY, and waits when nothing is.
+ */
+void worker_idle() {
+    finish_switch();
+    lock_scheduler_whole();
+    while (true) {
+        if (work_available() || !wait_for_work()) {
+            // this counts as a new quantum: a tick that was deferred while idle is served by it
+            preempt_pending = 0;
+            quantum_update_func(0);
+        }
+    }
+}
+
+/**
+ * @brief SIGVTALRM handler.
+ *
+ * If the tick interrupted library code it only records that a preemption is due; the interrupted call performs
+ * it when it leaves the library. The kernel keeps SIGVTALRM blocked while the handler runs, so no second tick
+ * lands its frame on top of this one on the thread's small stack, where two of them do not fit. The sigreturn
+ * that ends the handler unblocks it again, also for a thread that was preempted here and resumes here later; a
+ * switch into such a thread blocks it first if it is not blocked yet (see move_to_next_thread). A thread resumed
+ * by this handler that switched out some other way unblocks it itself (see tick_masked).
+ */
+void timer_handler(int) {
+    if (in_library > 0) {
+        preempt_pending = 1;
+        return;
+    }
+    in_library = 1;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    if (!lock_scheduler_for_switch(true)) {
+        // another worker holds the whole scheduler lock: rather than spin here, on top of a signal frame on a small
+        // thread stack, take the tick at this thread's next library call (or at the next tick)
+        in_library = 0;
+        preempt_pending = 1;
+        return;
+    }
+    tick_masked = 1;
+    preempt_pending = 0;
+    Thread *thread = current_thread;
+    thread->set_preempted(true);
+    quantum_update_func(QUANTUM_EXPIRED);
+    while (preempt_pending) {
+        preempt_pending = 0;
+        quantum_update_func(QUANTUM_EXPIRED);
+    }
+    thread->set_preempted(false);
+    unlock_scheduler();
+    in_library = 0;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    // a wake-up deferred since the loop above: its tick comes right after the return
+    if (preempt_pending) {
+        preempt_pending = 0;
+        arm_timer(self_worker, NSEC_PER_USEC);
+    }
+    // unblocked by the sigreturn
+    tick_masked = 0;
+}
+
+/**
+ * @brief WAKE_SIGNAL handler: wake_timer fired, a timed sleeper is due. Worker 0 starts a new quantum for it, which
+ * wakes the sleeper.
+ *
+ * Inside the library it defers like timer_handler. In user code it only arms worker 0's quantum timer to tick at
+ * once, also if the worker is tickless, and the tick comes through timer_handler as usual: the handler runs on
+ * worker 0's alternate signal stack with SIGVTALRM blocked, and never switches from there. Sending SIGVTALRM itself
+ * instead could queue it next to a timer's own and stack two frames on a STACK_SIZE thread stack, where they do
+ * not fit. A CPU clock only fires at the kernel's ticks, so next to a busy thread the sleeper is woken up to one of
+ * them late.
+ */
+void wake_handler(int) {
+    if (in_library > 0) {
+        preempt_pending = 1;
+        return;
+    }
+    arm_timer(self_worker, NSEC_PER_USEC);
+}
+
+/**
+ * @brief Points the calling kernel thread's alternate signal stack at the worker's wake_stack.
+ *
+ * Only worker 0 runs wake_handler there, but every worker needs one: a sigreturn restores the alternate stack the
+ * signal frame was made with, so a thread preempted on one worker and resumed on another carries that worker's
+ * setting over. With none on the others, worker 0 could lose its own and take the next wake-up on a thread stack.
+ */
+void set_wake_stack(Worker *worker) {
+    stack_t stack = {};
+    stack.ss_sp = worker->wake_stack;
+    stack.ss_size = sizeof(worker->wake_stack);
+    if (sigaltstack(&stack, NULL) < 0) {
+        std::cerr << SYSTEM_ERR << SIGACTION_ERR << std::endl;
+        exit(ERR_EXIT);
+    }
+}
+
+/**
+ * @brief Creates wake_timer, disarmed, signalling the calling kernel thread (worker 0).
+ */
+void create_wake_timer() {
+    struct sigevent event = {};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = WAKE_SIGNAL;
+    event._sigev_un._tid = gettid();
+    struct itimerspec disarmed = {};
+    // setting it once also binds timer_settime, which the timer handler calls
+    if (timer_create(CLOCK_MONOTONIC, &event, &wake_timer) < 0 ||
+        timer_settime(wake_timer, TIMER_ABSTIME, &disarmed, NULL) < 0) {
+        std::cerr << SYSTEM_ERR << TIMER_CREATE_ERR << std::endl;
+        exit(ERR_EXIT);
+    }
+}
+
+/**
+ * @brief Creates the quantum timer of the calling kernel thread, on its CPU clock and delivering SIGVTALRM to it
+ * alone.
+ */
+void create_worker_timer(Worker *worker) {
+    struct sigevent event = {};
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = SIGVTALRM;
+    event._sigev_un._tid = gettid();
+    if (pthread_getcpuclockid(pthread_self(), &worker->cpu_clock) != 0 ||
+        timer_create(worker->cpu_clock, &event, &worker->timer) < 0) {
+        std::cerr << SYSTEM_ERR << TIMER_CREATE_ERR << std::endl;
+        exit(ERR_EXIT);
+    }
+}
+
+/**
+ * @brief Binds the libc functions that only multi-worker scheduling calls, before any thread runs.
+ *
+ * The first call through a lazily bound PLT entry runs the dynamic linker's resolver, which saves the whole
+ * vector register file on the stack; from a signal handler on a STACK_SIZE thread stack that overflows it.
+ */
+void bind_worker_symbols() {
+    int unused = 0;
+    syscall(SYS_futex, &unused, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    sched_yield();
+}
+
+/**
+ * @brief Start routine of workers 1..n-1: becomes the worker's idle thread, on the pthread's own stack.
+ */
+void *worker_main(void *arg) {
+    Worker *worker = (Worker *) arg;
+    self_worker = worker;
+    current_thread = worker->idle;
+    in_library = 1;
+    set_wake_stack(worker);
+    create_worker_timer(worker);
+    lock_scheduler();
+    worker->run_start = monotonic_ns();
+    worker_idle();
+    return nullptr;
+}
+
+/**
+ * @brief The wait queue kept in the opaque storage of a uthread_mutex_t or uthread_cond_t.
+ */
+ReadyQueue *wait_queue(void *(&storage)[3]) {
+    static_assert(sizeof(ReadyQueue) <= sizeof(storage), "a ReadyQueue must fit in a wait_queue");
+    return reinterpret_cast<ReadyQueue *>(storage);
+}
+
+/**
+ * @brief Parks the running thread at the end of queue and schedules another one. Returns once the thread was
+ * unparked and runs again. Inside the library.
+ */
+void park(ReadyQueue *queue) {
+    set_waiting_state(current_thread, WAITING);
+    queue->push_back(current_thread);
+    quantum_update_func(0);
+}
+
+/**
+ * @brief Ends the wait of a thread taken off its wait queue: it becomes READY, or BLOCKED if it was blocked while
+ * waiting.
+ *
+ * The thread may still be this worker's running thread, on its way out: the I/O reactor is polled in the
+ * scheduler call that switches it out, and may find its descriptor ready already. It then just keeps running.
+ */
+void wake_waiter(Thread *thread) {
+    if (thread->get_state() == WAITING_AND_BLOCKED) {
+        thread->set_state(BLOCKED);
+    } else if (thread->get_worker() >= 0) {
+        thread->set_state(RUNNING);
+    } else {
+        make_ready(thread);
+    }
+}
+
+/**
+ * @brief Ends the wait of a thread a channel operation completed: like wake_waiter, except that a READY thread
+ * becomes this worker's run_next instead of going to the end of the run queue. If the running thread parks next,
+ * the CPU goes straight to it. A previous run_next is queued normally.
+ */
+void hand_off(Thread *thread) {
+    if (thread->get_state() == WAITING_AND_BLOCKED) {
+        thread->set_state(BLOCKED);
+        return;
+    }
+    if (idle_workers > 0) {
+        // another worker would run it at once, instead of after the running thread
+        make_ready(thread);
+        return;
+    }
+    Worker *worker = self_worker;
+    flush_run_next(worker);
+    thread->set_state(READY);
+    thread->add_entry();
+    worker->run_next = thread;
+    end_tickless(worker);
+}
+
+/**
+ * @brief Wakes the first thread of queue, see wake_waiter.
+ *
+ * @return The thread, or nullptr if queue was empty.
+ */
+Thread *unpark(ReadyQueue *queue) {
+    Thread *thread = queue->pop_front();
+    if (thread != nullptr) {
+        wake_waiter(thread);
+    }
+    return thread;
+}
+
+/**
+ * @brief True if threads wait for I/O: on descriptors in the reactor, or for file requests in flight.
+ */
+bool io_pending() {
+    return io_reactor.active() || file_io.active();
+}
+
+/**
+ * @brief Wakes the threads parked on the file descriptors that became ready, and those whose file requests
+ * completed, without waiting. Queued file requests are submitted first.
+ */
+void poll_io() {
+    if (io_reactor.active()) {
+        io_reactor.harvest([](ReadyQueue &queue) {
+            while (unpark(&queue) != nullptr) {
+            }
+        });
+    }
+    if (file_io.active()) {
+        file_io.harvest([](FileRequest *request) {
+            Thread *thread = request->thread;
+            if (thread->get_state() == TERMINATED) {
+                // terminated while waiting: the request's entry kept it, with the stack the kernel wrote to
+                settle_queued(thread);
+            } else {
+                thread->drop_entry();
+                wake_waiter(thread);
+            }
+        });
+    }
+}
+
+/**
+ * @brief Unlocks a locked mutex from inside the library, waking a waiter if there may be any.
+ *
+ * The woken thread locks the mutex again as MUTEX_CONTENDED, so the next unlock wakes the next waiter. A waiter
+ * that was blocked meanwhile only retries once resumed, so the following one is woken up as well.
+ */
+void release_mutex(uthread_mutex_t *mutex) {
+    if (__atomic_exchange_n(&mutex->state, MUTEX_UNLOCKED, __ATOMIC_RELEASE) == MUTEX_CONTENDED) {
+        Thread *thread;
+        do {
+            thread = unpark(wait_queue(mutex->wait_queue));
+        } while (thread != nullptr && thread->get_state() == BLOCKED);
+    }
+}
+
+Channel *as_channel(uthread_chan_t *chan) {
+    return reinterpret_cast<Channel *>(chan);
+}
+
+/**
+ * @brief Sends elem if that needs no waiting: straight to the first parked receiver, else into the buffer.
+ *
+ * @return false if the channel is full (always, for an unbuffered one) and no receiver waits.
+ */
+bool chan_send_now(Channel *channel, const void *elem) {
+    Thread *receiver = channel->receivers.pop_front();
+    if (receiver != nullptr) {
+        channel->copy(receiver->get_transfer(), elem);
+        hand_off(receiver);
+        return true;
+    }
+    if (!channel->full()) {
+        channel->push(elem);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Receives into elem if that needs no waiting: the oldest buffered element (whose slot then takes the
+ * element of the first parked sender), else straight from the first parked sender.
+ *
+ * @return false if the channel is empty and no sender waits.
+ */
+bool chan_recv_now(Channel *channel, void *elem) {
+    Thread *sender = channel->senders.pop_front();
+    if (!channel->empty()) {
+        channel->pop(elem);
+        if (sender != nullptr) {
+            channel->push(sender->get_transfer());
+        }
+    } else if (sender != nullptr) {
+        channel->copy(elem, sender->get_transfer());
+    } else {
+        return false;
+    }
+    if (sender != nullptr) {
+        hand_off(sender);
+    }
+    return true;
+}
+
+/**
+ * @brief Switches fd to non-blocking mode, if it is not already.
+ *
+ * @return false if fcntl failed (errno set).
+ */
+bool set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL);
+    return flags >= 0 && ((flags & O_NONBLOCK) != 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0);
+}
+
+/**
+ * @brief Parks the running thread until fd is readable (or writable, if write): the slow path of the I/O wrappers,
+ * called after the operation found fd not ready. Spurious returns are possible, the caller just tries again.
+ *
+ * @return false if fd cannot be waited for (errno set): the reactor could not be created, or epoll refuses fd.
+ */
+bool wait_io(int fd, bool write) {
+    enter_library();
+    Thread *thread = current_thread;
+    State state = thread->get_state();
+    set_waiting_state(thread, WAITING);
+    if (!io_reactor.open() || !io_reactor.park(thread, fd, write)) {
+        int error = errno;
+        thread->set_state(state);
+        leave_library();
+        errno = error;
+        return false;
+    }
+    quantum_update_func(0);
+    leave_library();
+    return true;
+}
+
+/**
+ * @brief Runs request (a read, or a write if request->write) asynchronously and parks the running thread until it
+ * completes: the slow path of uthread_pread and uthread_pwrite.
+ *
+ * @return false if the request could not be handed to the kernel: neither io_uring nor the fallback pool could be
+ * set up at uthread_init, or the submission ring is full.
+ */
+bool wait_file(FileRequest *request) {
+    enter_library();
+    Thread *thread = current_thread;
+    State state = thread->get_state();
+    set_waiting_state(thread, WAITING);
+    request->thread = thread;
+    if (!file_io.open() || !file_io.submit(request)) {
+        int error = errno;
+        thread->set_state(state);
+        leave_library();
+        errno = error;
+        return false;
+    }
+    quantum_update_func(0);
+    leave_library();
+    return true;
+}
+
+/**
+ * @brief uthread_pread or uthread_pwrite through the file I/O ring, or a plain blocking call if it is unavailable.
+ */
+ssize_t file_request(bool write, int fd, void *buf, size_t count, off_t offset) {
+    FileRequest request = {nullptr, write, fd, buf, std::min(count, (size_t) FILE_IO_MAX_COUNT), offset, 0, nullptr};
+    if (!wait_file(&request)) {
+        return write ? pwrite(fd, buf, count, offset) : pread(fd, buf, count, offset);
+    }
+    if (request.result < 0) {
+        errno = (int) -request.result;
+        return -1;
+    }
+    return request.result;
+}
+
+///////////////// library api /////////////////
+
+int uthread_init(int quantum_usecs, int max_threads, int num_workers) {
+    if (quantum_usecs <= 0) {
+        std::cout << LIBRARY_ERR << INVALID_QUANTUM_ERR << std::endl;
+        return ERR_CODE;
+    }
+    if (max_threads <= 0) {
+        std::cout << LIBRARY_ERR << INVALID_MAX_THREADS_ERR << std::endl;
+        return ERR_CODE;
+    }
+    if (num_workers <= 0) {
+        std::cout << LIBRARY_ERR << INVALID_WORKERS_ERR << std::endl;
+        return ERR_CODE;
+    }
+    thread_array.init(max_threads);
+    free_tids = TidBitmap(max_threads);
+    sleeping_threads.reserve(max_threads);
+    timed_sleepers.reserve(max_threads);
+    wait_table.init(max_threads);
+    run_queue.reserve(max_threads);
+    sig_act.sa_handler = &timer_handler;
+    sig_act.sa_flags = 0;
+    sigemptyset(&sig_act.sa_mask);
+    wake_act.sa_handler = &wake_handler;
+    wake_act.sa_flags = SA_ONSTACK;
+    sigemptyset(&wake_act.sa_mask);
+    sigaddset(&wake_act.sa_mask, SIGVTALRM);
+    if (sigaction(SIGVTALRM, &sig_act, NULL) < 0 || sigaction(WAKE_SIGNAL, &wake_act, NULL) < 0) {
+        std::cerr << SYSTEM_ERR << SIGACTION_ERR << std::endl;
+        exit(ERR_EXIT);
+    }
+    // also binds sigprocmask, which leave_library calls on a thread's small stack (see bind_worker_symbols)
+    sigemptyset(&timer_signal_set);
+    sigaddset(&timer_signal_set, SIGVTALRM);
+    sigprocmask(SIG_UNBLOCK, &timer_signal_set, NULL);
+#ifdef UTHREADS_TRACE
+    trace_buffer.start(num_workers);
+#endif
+    // set timer
+    itimer = {{quantum_usecs / TIME_SET, quantum_usecs % TIME_SET},
+              {quantum_usecs / TIME_SET, quantum_usecs % TIME_SET}};
+    quantum_spec = {{quantum_usecs / TIME_SET, (quantum_usecs % TIME_SET) * NSEC_PER_USEC},
+                    {quantum_usecs / TIME_SET, (quantum_usecs % TIME_SET) * NSEC_PER_USEC}};
+    quantum_ns = (uint64_t) quantum_usecs * NSEC_PER_USEC;
+    // set the workers; worker 0 is this kernel thread, its idle thread needs a stack of its own
+    worker_count = num_workers;
+    workers = new Worker[num_workers];
+    if (multi_worker()) {
+        sched_lock.init(num_workers);
+    }
+    for (int i = 0; i < num_workers; i++) {
+        workers[i].index = i;
+        if (use_deques()) {
+            workers[i].deque.reserve(max_threads);
+        }
+    }
+    size_t idle_stack_size = IDLE_STACK_SIZE;
+    char *idle_stack = stack_pool.acquire(idle_stack_size);
+    if (idle_stack == nullptr) {
+        std::cout << LIBRARY_ERR << NO_STACK_ERR << std::endl;
+        return ERR_CODE;
+    }
+    workers[0].pthread = pthread_self();
+    workers[0].idle = new Thread(IDLE_TID, nullptr, worker_idle, idle_stack, idle_stack_size);
+    self_worker = &workers[0];
+    // set main thread
+    Thread *main_thread = new Thread();
+    free_tids.acquire();
+    thread_array.set(0, main_thread);
+    current_thread = main_thread;
+    workers[0].run_start = monotonic_ns();
+    // quantum update
+    main_thread->incrament_quantums();
+    total_quantums++;
+    // here, on the caller's stack rather than on a thread's at its first uthread_pread; without it, that falls back
+    // to blocking calls
+    file_io.open();
+    set_wake_stack(&workers[0]);
+    create_wake_timer();
+    // binds getrusage, which the timer handler calls on a thread's small stack (see bind_worker_symbols)
+    worker_cpu_ns(&workers[0]);
+    if (multi_worker()) {
+        bind_worker_symbols();
+        create_worker_timer(&workers[0]);
+        for (int i = 1; i < num_workers; i++) {
+            workers[i].idle = new Thread(IDLE_TID);
+            workers[i].idle->set_worker(i);
+            if (pthread_create(&workers[i].pthread, NULL, worker_main, &workers[i]) != 0) {
+                std::cerr << SYSTEM_ERR << PTHREAD_CREATE_ERR << std::endl;
+                exit(ERR_EXIT);
+            }
+        }
+    }
+    set_timer(main_thread);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Creates a new thread, whose entry point is the function entry_point with the signature
+ * void entry_point(void).
+ *
+ * The thread is added to the end of the READY threads list.
+ * The uthread_spawn function should fail if it would cause the number of concurrent threads to exceed the
+ * limit given to uthread_init (MAX_THREAD_NUM by default).
+ * Each thread should be allocated with a stack of size STACK_SIZE bytes.
+ * It is an error to call this function with a null entry_point.
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn(thread_entry_point entry_point){
+    return uthread_spawn_ex(entry_point, nullptr);
+}
+
+/**
+ * @brief Creates a new thread like uthread_spawn, with the creation attributes in attrs.
+ *
+ * attrs->stack_size selects the stack size (rounded up to whole pages); NULL attrs or a zero size mean STACK_SIZE.
+ * Stacks larger than STACK_SIZE are reserved but not committed: memory is only used for the pages the thread
+ * actually touches (see uthread_get_stack_committed).
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn_ex(thread_entry_point entry_point, const uthread_attr_t *attrs){
+    enter_library();
+    if (entry_point == nullptr) {
+        return library_error_handler(NO_ENTRY_POINT_ERR);
+    }
+    int tid = find_minimal_tid();
+    if (tid == -1) {
+        return library_error_handler(NO_FREE_TID_ERR);
+    }
+    size_t stack_size = (attrs != nullptr && attrs->stack_size > 0) ? attrs->stack_size : STACK_SIZE;
+    char *stack = stack_pool.acquire(stack_size);
+    if (stack == nullptr) {
+        free_tids.release(tid);
+        return library_error_handler(NO_STACK_ERR);
+    }
+    Thread *new_thread = new Thread(tid, entry_point, thread_start, stack, stack_size);
+    thread_array.set(tid, new_thread);
+    TRACE_EVENT(TRACE_SPAWN, tid, 0);
+    // queued on the spawning worker; idle workers steal it from there
+    make_ready(new_thread);
+    leave_library();
+    return tid;
+}
+
+/**
+ * @brief Terminates the thread with ID tid and deletes it from all relevant control structures.
+ *
+ * All the resources allocated by the library for this thread should be released. If no thread with ID tid exists it
+ * is considered an error. Terminating the main thread (tid == 0) will result in the termination of the entire
+ * process using exit(0) (after releasing the assigned library memory).
+ *
+ * @return The function returns 0 if the thread was successfully terminated and -1 otherwise. If a thread terminates
+ * itself or the main thread is terminated, the function does not return.
+*/
+int uthread_terminate(int tid){
+    enter_library();
+    if(!valid_thread(tid)){
+        return library_error_handler(INVALID_THREAD_ERR);
+    }
+    TRACE_EVENT(TRACE_TERMINATE, tid, 0);
+    // terminate the main thread
+    if(tid == MAIN_THREAD) {
+        destroy_threads();
+        exit(EXIT_SUCCESS);
+    }
+    Thread *thread = thread_array[tid];
+    // terminate itself
+    if (thread == current_thread) {
+        sleeping_threads.erase(thread);
+        timed_sleepers.erase(thread);
+        // still running on this stack: the next thread frees it; its CPU holds an entry until then
+        thread->set_state(TERMINATED);
+        thread->add_entry();
+        self_worker->dead = thread;
+        thread_array.set(tid, nullptr);
+        free_tids.release(tid);
+        current_thread = nullptr;
+        quantum_update_func(0);
+    }
+    else {
+        wait_table.erase(thread);
+        io_reactor.erase(thread);
+        remove_thread_from_ready(tid);
+        sleeping_threads.erase(thread);
+        timed_sleepers.erase(thread);
+        if (thread->get_worker() >= 0 || thread->is_queued()) {
+            // running on another worker, or on a deque: freed when that worker next enters the scheduler, or when
+            // the last entry is taken off its deque
+            thread->set_state(TERMINATED);
+            if (thread->get_worker() >= 0) {
+                // an entry for its CPU, dropped once that worker is off its stack (finish_switch)
+                thread->add_entry();
+                kick_worker(&workers[thread->get_worker()]);
+            }
+        } else {
+            free_thread(thread);
+        }
+        thread_array.set(tid, nullptr);
+        free_tids.release(tid);
+    }
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Blocks the thread with ID tid. The thread may be resumed later using uthread_resume.
+ *
+ * If no thread with ID tid exists it is considered as an error. In addition, it is an error to try blocking the
+ * main thread (tid == 0). If a thread blocks itself, a scheduling decision should be made. Blocking a thread in
+ * BLOCKED state has no effect and is not considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_block(int tid){
+    enter_library();
+    if(tid == 0 || !valid_thread(tid)){
+        return library_error_handler(INVALID_THREAD_ERR);
+    }
+    TRACE_EVENT(TRACE_BLOCK, tid, 0);
+    State thread_state = thread_array[tid]->get_state();
+    if(thread_state != BLOCKED && thread_state != SLEEPING_AND_BLOCKED && thread_state != WAITING_AND_BLOCKED) {
+        if (thread_state == SLEEPING) {
+            thread_array[tid]->set_state(SLEEPING_AND_BLOCKED);
+        } else if (thread_state == WAITING) {
+            // stays parked; when woken up it becomes BLOCKED instead of READY
+            thread_array[tid]->set_state(WAITING_AND_BLOCKED);
+        } else {
+            // if it runs on another worker, it is switched out (and not queued again) at that worker's next tick
+            thread_array[tid]->set_state(BLOCKED);
+            if (thread_array[tid] != current_thread && thread_array[tid]->get_worker() >= 0) {
+                kick_worker(&workers[thread_array[tid]->get_worker()]);
+            }
+        }
+    }
+    if (thread_array[tid] == current_thread) {
+        quantum_update_func(0);
+    }
+    if (thread_state == READY) {
+        remove_thread_from_ready(tid);
+    }
+    leave_library();
+    return 0;
+}
+
+/**
+ * @brief Resumes a blocked thread with ID tid and moves it to the READY `state.`
+ *
+ * Resuming a thread in a RUNNING or READY state has no effect and is not considered as an error. If no thread with
+ * ID tid exists it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_resume(int tid){
+    enter_library();
+    if(!valid_thread(tid)){
+        return library_error_handler(INVALID_THREAD_ERR);
+    }
+    TRACE_EVENT(TRACE_RESUME, tid, 0);
+    State thread_state = thread_array[tid]->get_state();
+    if(thread_state == SLEEPING_AND_BLOCKED){
+        thread_array[tid]->set_state(SLEEPING);
+    } 
+    if(thread_state == WAITING_AND_BLOCKED){
+        thread_array[tid]->set_state(WAITING);
+    }
+    if(thread_state == BLOCKED){
+        unblock(thread_array[tid]);
+    }
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Blocks the RUNNING thread for num_quantums quantums.
+ *
+ * Immediately after the RUNNING thread transitions to the BLOCKED state a scheduling decision should be made.
+ * After the sleeping time is over, the thread should go back to the end of the READY queue.
+ * If the thread which was just RUNNING should also be added to the READY queue, or if multiple threads wake up 
+ * at the same time, the order in which they're added to the end of the READY queue doesn't matter.
+ * The number of quantums refers to the number of times a new quantum starts, regardless of the reason. Specifically,
+ * the quantum of the thread which has made the call to uthread_sleep isn’t counted.
+ * It is considered an error if the main thread (tid == 0) calls this function.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sleep(int num_quantums) {
+    enter_library();
+    if (current_thread == thread_array[0]) {
+        return library_error_handler(MAIN_SLEEP_ERR);
+    }
+    // the sleep counts from the quantum this thread is really in, not the one its worker last counted
+    if (self_worker->tickless) {
+        catch_up_quantums(self_worker);
+    }
+    TRACE_EVENT(TRACE_SLEEP, current_thread->get_tid(), 0);
+    set_waiting_state(current_thread, SLEEPING);
+    sleeping_threads.push(current_thread, total_quantums + num_quantums);
+    quantum_update_func(0);
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Sleeps until time deadline (nanoseconds on CLOCK_MONOTONIC): the common part of uthread_sleep_for and
+ * uthread_sleep_until, inside the library.
+ */
+void sleep_until_ns(uint64_t deadline) {
+    TRACE_EVENT(TRACE_SLEEP, current_thread->get_tid(), 0);
+    set_waiting_state(current_thread, SLEEPING);
+    // 0 is no time in wake_timer_at
+    timed_sleepers.push(current_thread, std::max(deadline, (uint64_t) 1));
+    arm_wake_timer();
+    quantum_update_func(0);
+}
+
+/**
+ * @brief Blocks the RUNNING thread for usec microseconds of wall-clock time (CLOCK_MONOTONIC).
+ *
+ * Unlike uthread_sleep, the sleep does not depend on how many quantums start meanwhile, nor on whether the process
+ * runs at all: a timer on the monotonic clock, armed for the earliest such deadline only, ticks when it is due
+ * and the thread goes back to the end of the READY queue. While other threads keep the CPU busy, the wake-up comes
+ * at the kernel's next scheduler tick after that. It is an error if usec is negative or if the main thread
+ * (tid == 0) calls this function.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sleep_for(long usec) {
+    enter_library();
+    if (current_thread == thread_array[0]) {
+        return library_error_handler(MAIN_SLEEP_ERR);
+    }
+    if (usec < 0) {
+        return library_error_handler(INVALID_SLEEP_ERR);
+    }
+    sleep_until_ns(saturating_ns(monotonic_ns(), (uint64_t) usec, NSEC_PER_USEC));
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Blocks the RUNNING thread until the CLOCK_MONOTONIC time *deadline (see uthread_sleep_for). A deadline
+ * that has passed already only gives up the CPU.
+ *
+ * It is an error if deadline is NULL or not a valid time (tv_nsec out of range, or a negative tv_sec), or if the
+ * main thread (tid == 0) calls this function.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sleep_until(const struct timespec *deadline) {
+    enter_library();
+    if (current_thread == thread_array[0]) {
+        return library_error_handler(MAIN_SLEEP_ERR);
+    }
+    if (deadline == nullptr || deadline->tv_sec < 0 || deadline->tv_nsec < 0 ||
+        deadline->tv_nsec >= (long) NSEC_PER_SEC) {
+        return library_error_handler(INVALID_SLEEP_ERR);
+    }
+    sleep_until_ns(saturating_ns(deadline->tv_nsec, (uint64_t) deadline->tv_sec, NSEC_PER_SEC));
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Gives up the CPU: the RUNNING thread goes to the end of the READY queue and a scheduling decision is made.
+ *
+ * The switch is done directly in user space, without going through the timer signal. It counts as the start of a
+ * new quantum exactly like a preemption (total quantums, the next thread's quantums and sleeping threads all
+ * advance), and the next thread gets a full quantum. If no other thread is READY the caller keeps running in a
+ * new quantum.
+ *
+ * @return On success, return 0.
+*/
+int uthread_yield() {
+    enter_scheduler();
+    // this switch also serves a tick that was deferred while we were in the library
+    preempt_pending = 0;
+    quantum_update_func(0);
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Gives up the CPU to the READY thread with ID tid: it runs right away, ahead of the threads queued before
+ * it, and the RUNNING thread goes to the end of the READY queue.
+ *
+ * Meant for a thread that has just made another one READY (e.g. with uthread_resume) and should hand it the CPU
+ * now rather than after the whole queue. Like uthread_yield it starts a new quantum, which the target gets in
+ * full. If no thread with ID tid exists, or it is not READY (the caller itself is RUNNING), it is considered an
+ * error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_switch_to(int tid) {
+    enter_library();
+    if (!valid_thread(tid)) {
+        return library_error_handler(INVALID_THREAD_ERR);
+    }
+    Thread *next = thread_array[tid];
+    if (next->get_state() != READY) {
+        return library_error_handler(NOT_READY_ERR);
+    }
+    Worker *worker = self_worker;
+    if (worker->run_next == next) {
+        worker->run_next = nullptr;
+        next->drop_entry();
+    }
+    // a deque entry cannot be unlinked: it stays behind, stale, and is dropped by whoever takes it
+    remove_thread_from_ready(tid);
+    preempt_pending = 0;
+    charge_running(worker);
+    start_quantum();
+    Thread *prev = current_thread;
+    run_queue.stopped(prev, false);
+    // not if another worker blocked it meanwhile (see set_waiting_state)
+    if (not_block_or_sleep(prev->get_state())) {
+        make_ready(prev);
+    }
+    set_timer(next);
+    move_to_next_thread(prev, next);
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Returns the thread ID of the calling thread.
+ *
+ * @return The ID of the calling thread.
+*/
+int uthread_get_tid(){
+    return current_thread->get_tid();
+}
+
+/**
+ * @brief Returns the total number of quantums since the library was initialized, including the current quantum.
+ *
+ * Right after the call to uthread_init, the value should be 1.
+ * Each time a new quantum starts, regardless of the reason, this number should be increased by 1.
+ *
+ * @return The total number of quantums.
+*/
+int uthread_get_total_quantums(){
+    enter_library();
+    // tickless workers count their quantums lazily
+    int quantums = total_quantums;
+    for (int i = 0; i < worker_count; i++) {
+        quantums += skipped_quantums(&workers[i]);
+    }
+    leave_library();
+    return quantums;
+}
+
+/**
+ * @brief Returns the number of quantums the thread with ID tid was in RUNNING state.
+ *
+ * On the first time a thread runs, the function should return 1. Every additional quantum that the thread starts should
+ * increase this value by 1 (so if the thread with ID tid is in RUNNING state when this function is called, include
+ * also the current quantum). If no thread with ID tid exists it is considered an error.
+ *
+ * @return On success, return the number of quantums of the thread with ID tid. On failure, return -1.
+*/
+int uthread_get_quantums(int tid){
+    enter_library();
+    if(!valid_thread(tid)){
+        return library_error_handler(INVALID_THREAD_ERR);
+    }
+    Thread *thread = thread_array[tid];
+    int quantums = thread->get_quantums();
+    if (thread->get_worker() >= 0) {
+        quantums += skipped_quantums(&workers[thread->get_worker()]);
+    }
+    leave_library();
+    return quantums;
+}
+
+/**
+ * @brief Returns how many bytes of the stack of the thread with ID tid are committed (backed by memory).
+ *
+ * Stack pages are committed when first touched and stay committed. A stack larger than STACK_SIZE is mapped for
+ * its thread alone, so for it this is the deepest the thread's stack has been so far, rounded to pages. Stacks of
+ * STACK_SIZE are recycled as they are, still committed, from one thread to the next (see StackPool): for them it
+ * also counts the pages earlier owners of the stack touched, up to the whole stack. The main thread runs on the
+ * process stack, which is not tracked: it reports 0. If no thread with ID tid exists it is considered an error.
+ *
+ * @return On success, return the number of committed bytes. On failure, return -1.
+*/
+long uthread_get_stack_committed(int tid){
+    enter_library();
+    if(!valid_thread(tid)){
+        return library_error_handler(INVALID_THREAD_ERR);
+    }
+    Thread *thread = thread_array[tid];
+    long committed = 0;
+    if (thread->get_stack() != nullptr) {
+        committed = (long) stack_pool.committed(thread->get_stack(), thread->get_stack_size());
+    }
+    leave_library();
+    return committed;
+}
+
+/**
+ * @brief Returns how many times a worker took a READY thread from another worker's run queue.
+ *
+ * With a single worker nothing is ever stolen and this is 0.
+ *
+ * @return The number of steals since uthread_init.
+*/
+long uthread_get_steals(){
+    enter_library();
+    long steals = 0;
+    for (int i = 0; i < worker_count; i++) {
+        steals += workers[i].steals;
+    }
+    leave_library();
+    return steals;
+}
+
+/**
+ * @brief Initializes mutex as unlocked, with no waiting threads.
+ *
+ * It is an error to call this function with a null mutex.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_init(uthread_mutex_t *mutex){
+    if (mutex == nullptr) {
+        enter_library();
+        return library_error_handler(INVALID_MUTEX_ERR);
+    }
+    mutex->state = MUTEX_UNLOCKED;
+    new (wait_queue(mutex->wait_queue)) ReadyQueue();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Locks mutex, waiting for it if another thread holds it.
+ *
+ * Locking a free mutex is a single atomic operation. A thread that has to wait is parked in the mutex's queue: it
+ * is not scheduled (and uses no quantums) until the holder unlocks, and a scheduling decision is made right away.
+ * Blocking a waiting thread keeps it waiting, and it is BLOCKED instead of READY once it gets its turn. The mutex
+ * is not recursive: a thread locking a mutex it holds waits forever. It is an error to call this function with a
+ * null mutex.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_lock(uthread_mutex_t *mutex){
+    int unlocked = MUTEX_UNLOCKED;
+    if (mutex != nullptr && __atomic_compare_exchange_n(&mutex->state, &unlocked, MUTEX_LOCKED, false,
+                                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return EXIT_SUCCESS;
+    }
+    enter_library();
+    if (mutex == nullptr) {
+        return library_error_handler(INVALID_MUTEX_ERR);
+    }
+    // the holder's unlock needs the library (and, with several workers, the scheduler lock) to wake us, so it
+    // cannot slip in between the exchange and the park
+    while (__atomic_exchange_n(&mutex->state, MUTEX_CONTENDED, __ATOMIC_ACQUIRE) != MUTEX_UNLOCKED) {
+        park(wait_queue(mutex->wait_queue));
+    }
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Locks mutex if it is free, without waiting.
+ *
+ * @return 0 if the mutex was locked by this call, 1 if another thread holds it, -1 on failure (a null mutex).
+*/
+int uthread_mutex_trylock(uthread_mutex_t *mutex){
+    if (mutex == nullptr) {
+        enter_library();
+        return library_error_handler(INVALID_MUTEX_ERR);
+    }
+    int unlocked = MUTEX_UNLOCKED;
+    return __atomic_compare_exchange_n(&mutex->state, &unlocked, MUTEX_LOCKED, false, __ATOMIC_ACQUIRE,
+                                       __ATOMIC_RELAXED) ? 0 : 1;
+}
+
+/**
+ * @brief Unlocks mutex, which the calling thread must hold, and makes the first thread waiting for it READY.
+ *
+ * Unlocking a mutex nobody waits for is a single atomic operation. It is an error to call this function with a
+ * null mutex or a mutex that is not locked.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_unlock(uthread_mutex_t *mutex){
+    int locked = MUTEX_LOCKED;
+    if (mutex != nullptr && __atomic_compare_exchange_n(&mutex->state, &locked, MUTEX_UNLOCKED, false,
+                                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        return EXIT_SUCCESS;
+    }
+    enter_library();
+    if (mutex == nullptr) {
+        return library_error_handler(INVALID_MUTEX_ERR);
+    }
+    if (__atomic_load_n(&mutex->state, __ATOMIC_RELAXED) == MUTEX_UNLOCKED) {
+        return library_error_handler(MUTEX_NOT_LOCKED_ERR);
+    }
+    release_mutex(mutex);
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Initializes cond with no waiting threads.
+ *
+ * It is an error to call this function with a null cond.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_init(uthread_cond_t *cond){
+    if (cond == nullptr) {
+        enter_library();
+        return library_error_handler(INVALID_COND_ERR);
+    }
+    new (wait_queue(cond->wait_queue)) ReadyQueue();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Unlocks mutex and waits on cond until another thread signals it, then locks mutex again.
+ *
+ * Unlocking and starting to wait is atomic: a signal sent by a thread that locked mutex after this call released it
+ * is never lost. The waiting thread is parked like a mutex waiter. The condition must be checked again on return,
+ * in a loop. It is an error to call this function with a null cond or mutex, or with a mutex that is not locked.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_wait(uthread_cond_t *cond, uthread_mutex_t *mutex){
+    enter_library();
+    if (cond == nullptr) {
+        return library_error_handler(INVALID_COND_ERR);
+    }
+    if (mutex == nullptr) {
+        return library_error_handler(INVALID_MUTEX_ERR);
+    }
+    if (__atomic_load_n(&mutex->state, __ATOMIC_RELAXED) == MUTEX_UNLOCKED) {
+        return library_error_handler(MUTEX_NOT_LOCKED_ERR);
+    }
+    // signalling needs the library too, so nobody can signal between the release and the park
+    release_mutex(mutex);
+    park(wait_queue(cond->wait_queue));
+    leave_library();
+    return uthread_mutex_lock(mutex);
+}
+
+/**
+ * @brief Makes the first thread waiting on cond READY (BLOCKED if it was blocked meanwhile). Has no effect if no
+ * thread waits on cond.
+ *
+ * It is an error to call this function with a null cond.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_signal(uthread_cond_t *cond){
+    enter_library();
+    if (cond == nullptr) {
+        return library_error_handler(INVALID_COND_ERR);
+    }
+    unpark(wait_queue(cond->wait_queue));
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Like uthread_cond_signal, for every thread waiting on cond.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_broadcast(uthread_cond_t *cond){
+    enter_library();
+    if (cond == nullptr) {
+        return library_error_handler(INVALID_COND_ERR);
+    }
+    while (unpark(wait_queue(cond->wait_queue)) != nullptr) {
+    }
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Waits on addr if *addr still equals expected, until another thread calls uthread_wake on addr.
+ *
+ * Checking *addr and starting to wait is atomic with respect to uthread_wake: a thread that changes *addr and then
+ * wakes addr never misses this one. The waiting thread is parked like a mutex waiter (WAITING, no quantums), and
+ * like any such primitive the caller must check its condition again on return. Waiters of an address are woken in
+ * FIFO order. It is an error to call this function with a null addr.
+ *
+ * @return 0 after being woken up, 1 if *addr did not equal expected (the thread did not wait), -1 on failure.
+*/
+int uthread_wait(int *addr, int expected){
+    enter_library();
+    if (addr == nullptr) {
+        return library_error_handler(INVALID_ADDRESS_ERR);
+    }
+    if (__atomic_load_n(addr, __ATOMIC_ACQUIRE) != expected) {
+        leave_library();
+        return 1;
+    }
+    park(wait_table.enqueue(current_thread, addr));
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Wakes up to n threads waiting on addr, the longest-waiting first.
+ *
+ * A woken thread becomes READY, or BLOCKED if it was blocked while waiting. The cost is proportional to the
+ * number of threads woken, not to the number of threads waiting. It is an error to call this function with a
+ * null addr.
+ *
+ * @return On success, return the number of threads woken up. On failure, return -1.
+*/
+int uthread_wake(int *addr, int n){
+    enter_library();
+    if (addr == nullptr) {
+        return library_error_handler(INVALID_ADDRESS_ERR);
+    }
+    int woken = 0;
+    Thread *thread;
+    while (woken < n && (thread = wait_table.pop(addr)) != nullptr) {
+        wake_waiter(thread);
+        woken++;
+    }
+    leave_library();
+    return woken;
+}
+
+/**
+ * @brief Creates a channel carrying elements of elem_size bytes, buffering up to capacity of them.
+ *
+ * With capacity 0 the channel is unbuffered: every send waits for a receiver and the other way around. It is an
+ * error to call this function with a zero elem_size or a negative capacity.
+ *
+ * @return On success, return the channel. On failure, return NULL.
+*/
+uthread_chan_t *uthread_chan_create(size_t elem_size, int capacity){
+    enter_library();
+    if (elem_size == 0 || capacity < 0) {
+        library_error_handler(INVALID_CHANNEL_SIZE_ERR);
+        return nullptr;
+    }
+    Channel *channel = new Channel(elem_size, capacity);
+    leave_library();
+    return reinterpret_cast<uthread_chan_t *>(channel);
+}
+
+/**
+ * @brief Destroys chan, dropping the elements still buffered in it.
+ *
+ * It is an error to call this function with a null chan or while threads wait on it.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_chan_destroy(uthread_chan_t *chan){
+    enter_library();
+    if (chan == nullptr) {
+        return library_error_handler(INVALID_CHANNEL_ERR);
+    }
+    Channel *channel = as_channel(chan);
+    if (!channel->senders.empty() || !channel->receivers.empty()) {
+        return library_error_handler(CHANNEL_IN_USE_ERR);
+    }
+    delete channel;
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Sends a copy of the element at elem on chan, waiting while the channel is full.
+ *
+ * A receiver waiting on the channel gets the element directly, without going through the buffer, and runs next
+ * on this worker if the sender itself waits right after. A waiting sender is parked like a mutex waiter (WAITING,
+ * no quantums) and its element is taken directly from elem. Elements are received in the order they were sent.
+ * It is an error to call this function with a null chan or elem.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_chan_send(uthread_chan_t *chan, const void *elem){
+    enter_library();
+    if (chan == nullptr) {
+        return library_error_handler(INVALID_CHANNEL_ERR);
+    }
+    if (elem == nullptr) {
+        return library_error_handler(INVALID_ELEMENT_ERR);
+    }
+    Channel *channel = as_channel(chan);
+    if (!chan_send_now(channel, elem)) {
+        // the receiver that takes the element copies it from elem and makes us READY
+        current_thread->set_transfer(const_cast<void *>(elem));
+        park(&channel->senders);
+    }
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Receives the oldest element of chan into elem, waiting while the channel is empty.
+ *
+ * Like uthread_chan_send, a waiting receiver is parked and gets its element copied directly into elem. It is an
+ * error to call this function with a null chan or elem.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_chan_recv(uthread_chan_t *chan, void *elem){
+    enter_library();
+    if (chan == nullptr) {
+        return library_error_handler(INVALID_CHANNEL_ERR);
+    }
+    if (elem == nullptr) {
+        return library_error_handler(INVALID_ELEMENT_ERR);
+    }
+    Channel *channel = as_channel(chan);
+    if (!chan_recv_now(channel, elem)) {
+        current_thread->set_transfer(elem);
+        park(&channel->receivers);
+    }
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Sends like uthread_chan_send if that needs no waiting.
+ *
+ * @return 0 if the element was sent, 1 if the channel is full (nothing was sent), -1 on failure.
+*/
+int uthread_chan_try_send(uthread_chan_t *chan, const void *elem){
+    enter_library();
+    if (chan == nullptr) {
+        return library_error_handler(INVALID_CHANNEL_ERR);
+    }
+    if (elem == nullptr) {
+        return library_error_handler(INVALID_ELEMENT_ERR);
+    }
+    bool sent = chan_send_now(as_channel(chan), elem);
+    leave_library();
+    return sent ? 0 : 1;
+}
+
+/**
+ * @brief Receives like uthread_chan_recv if that needs no waiting.
+ *
+ * @return 0 if an element was received, 1 if the channel is empty (elem is untouched), -1 on failure.
+*/
+int uthread_chan_try_recv(uthread_chan_t *chan, void *elem){
+    enter_library();
+    if (chan == nullptr) {
+        return library_error_handler(INVALID_CHANNEL_ERR);
+    }
+    if (elem == nullptr) {
+        return library_error_handler(INVALID_ELEMENT_ERR);
+    }
+    bool received = chan_recv_now(as_channel(chan), elem);
+    leave_library();
+    return received ? 0 : 1;
+}
+
+/**
+ * @brief Sets the priority of the thread with ID tid: 0 is the highest, UTHREAD_PRIORITIES - 1 the lowest.
+ *
+ * Threads start with priority 0. Only the MLFQ policy (built with -DUTHREADS_POLICY=MlfqPolicy) schedules by
+ * priority: a thread starts at the level of its priority, sinks a level for every quantum it uses up, rises back
+ * a level (never above its priority) whenever it gives up the CPU before the end of its quantum, and returns to
+ * its priority's level every MLFQ_BOOST_QUANTUMS quantums so that CPU-bound threads cannot starve. The other
+ * policies keep the priority but ignore it. If no thread with ID tid exists or prio is out of range, it is
+ * considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_priority(int tid, int prio) {
+    enter_library();
+    if (!valid_thread(tid)) {
+        return library_error_handler(INVALID_THREAD_ERR);
+    }
+    if (prio < 0 || prio >= UTHREAD_PRIORITIES) {
+        return library_error_handler(INVALID_PRIORITY_ERR);
+    }
+    Thread *thread = thread_array[tid];
+    // a READY thread is queued by its priority: take it out while that changes
+    bool queued = run_queue.erase(thread);
+    thread->set_priority(prio);
+    if (queued) {
+        run_queue.push(thread);
+    }
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Returns how long the thread with ID tid has run, in nanoseconds.
+ *
+ * The time is measured at every switch (on the monotonic clock), so a thread that gives up the CPU right after
+ * being switched in is only charged for that moment, not for a quantum. For a RUNNING thread it includes the time
+ * up to this call. If no thread with ID tid exists it is considered an error.
+ *
+ * @return On success, return the run time of the thread with ID tid. On failure, return -1.
+*/
+long uthread_get_runtime(int tid) {
+    enter_library();
+    if (!valid_thread(tid)) {
+        return library_error_handler(INVALID_THREAD_ERR);
+    }
+    Thread *thread = thread_array[tid];
+    uint64_t runtime = thread->get_runtime();
+    if (thread->get_state() == RUNNING && thread->get_worker() >= 0) {
+        runtime += monotonic_ns() - workers[thread->get_worker()].run_start;
+    }
+    leave_library();
+    return (long) runtime;
+}
+
+/**
+ * @brief Sets the weight of the thread with ID tid: its share of the CPU under the CFS policy.
+ *
+ * Threads start with weight UTHREAD_DEFAULT_WEIGHT. Under the CFS policy (built with -DUTHREADS_POLICY=CfsPolicy)
+ * the READY thread that has run least, in run time divided by weight, runs next, so threads that are always READY
+ * share the CPU in proportion to their weights. The other policies keep the weight but ignore it. If no thread
+ * with ID tid exists or weight is not positive, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_weight(int tid, int weight) {
+    enter_library();
+    if (!valid_thread(tid)) {
+        return library_error_handler(INVALID_THREAD_ERR);
+    }
+    if (weight <= 0) {
+        return library_error_handler(INVALID_WEIGHT_ERR);
+    }
+    // the weight only scales the run time still to come, so a queued thread keeps its place
+    thread_array[tid]->set_weight(weight);
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Makes the thread with ID tid a real-time thread that runs periodic jobs: one job every period_us
+ * microseconds, each due by the end of its period and entitled to budget_us microseconds of CPU.
+ *
+ * The first job is released now. A job ends when the thread calls uthread_wait_period, which sleeps until the
+ * next release; a job that ends after its deadline counts as a deadline miss (uthread_get_deadline_misses). Under
+ * the EDF policy (built with -DUTHREADS_POLICY=EdfPolicy) the READY job with the earliest deadline runs first, for
+ * at most its budget; after that it only runs, in FIFO order with the ordinary threads, while no job with budget
+ * left is READY. The other policies keep the parameters but ignore them; jobs, releases and misses work the same.
+ * A period_us of 0 makes the thread an ordinary thread again (budget_us is then ignored). If no thread with ID tid
+ * exists, or budget_us is not between 1 and period_us, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_deadline(int tid, int period_us, int budget_us) {
+    enter_library();
+    if (!valid_thread(tid)) {
+        return library_error_handler(INVALID_THREAD_ERR);
+    }
+    if (period_us < 0 || (period_us > 0 && (budget_us <= 0 || budget_us > period_us))) {
+        return library_error_handler(INVALID_DEADLINE_ERR);
+    }
+    Thread *thread = thread_array[tid];
+    // a READY thread is queued by its deadline and budget: take it out while they change
+    bool queued = run_queue.erase(thread);
+    if (period_us == 0) {
+        thread->set_deadline(0, 0, 0);
+    } else {
+        thread->set_deadline((uint64_t) period_us * NSEC_PER_USEC, (uint64_t) budget_us * NSEC_PER_USEC,
+                             monotonic_ns());
+    }
+    if (queued) {
+        run_queue.push(thread);
+    }
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Ends the current job of the calling real-time thread and sleeps until its next job is released.
+ *
+ * That is the end of the job's period if the job ended in time. A late job counts as a deadline miss, and the
+ * next job is released at the first period boundary after now: the releases the late job overran are skipped. The
+ * sleep is on the monotonic clock, not in quantums. It is an error if the calling thread has no deadline (see
+ * uthread_set_deadline) or is the main thread (tid == 0).
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_wait_period() {
+    enter_library();
+    Thread *thread = current_thread;
+    if (thread == thread_array[0]) {
+        return library_error_handler(MAIN_SLEEP_ERR);
+    }
+    if (!thread->is_real_time()) {
+        return library_error_handler(NOT_REAL_TIME_ERR);
+    }
+    // the job's last stretch is charged to it, not to the next job's budget
+    Worker *worker = self_worker;
+    charge_running(worker);
+    uint64_t release = thread->next_job(worker->run_start);
+    TRACE_EVENT(TRACE_SLEEP, thread->get_tid(), 0);
+    set_waiting_state(thread, SLEEPING);
+    timed_sleepers.push(thread, release);
+    arm_wake_timer();
+    quantum_update_func(0);
+    leave_library();
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Returns how many jobs of the thread with ID tid ended after their deadline.
+ *
+ * If no thread with ID tid exists it is considered an error.
+ *
+ * @return On success, return the number of deadline misses of the thread with ID tid. On failure, return -1.
+*/
+long uthread_get_deadline_misses(int tid) {
+    enter_library();
+    if (!valid_thread(tid)) {
+        return library_error_handler(INVALID_THREAD_ERR);
+    }
+    long misses = thread_array[tid]->get_deadline_misses();
+    leave_library();
+    return misses;
+}
+
+/**
+ * @brief Reads up to count bytes from fd into buf like read(2), parking the calling thread instead of blocking
+ * the process while there is nothing to read.
+ *
+ * A parked thread is WAITING (no quantums) until the scheduler's epoll reactor finds fd readable: the reactor is
+ * polled whenever no thread is READY, at every quantum tick, and by an idle worker that sleeps on it. Sockets are
+ * read with MSG_DONTWAIT; any other descriptor is switched to O_NONBLOCK (and left so). A regular file, which
+ * epoll cannot watch, is read as by read(2).
+ *
+ * @return As read(2): the number of bytes read, 0 at end of file, or -1 with errno set.
+*/
+ssize_t uthread_read(int fd, void *buf, size_t count) {
+    while (true) {
+        ssize_t ret = recv(fd, buf, count, MSG_DONTWAIT);
+        if (ret < 0 && errno == ENOTSOCK) {
+            if (!set_nonblocking(fd)) {
+                return -1;
+            }
+            ret = read(fd, buf, count);
+        }
+        if (ret >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK) || !wait_io(fd, false)) {
+            return ret;
+        }
+    }
+}
+
+/**
+ * @brief Writes the count bytes at buf to fd like a blocking write(2), parking the calling thread while fd is
+ * full (see uthread_read).
+ *
+ * @return The number of bytes written, count unless an error stopped it early; -1 with errno set if nothing was
+ * written.
+*/
+ssize_t uthread_write(int fd, const void *buf, size_t count) {
+    size_t written = 0;
+    while (written < count) {
+        const char *rest = (const char *) buf + written;
+        ssize_t ret = send(fd, rest, count - written, MSG_DONTWAIT);
+        if (ret < 0 && errno == ENOTSOCK) {
+            if (!set_nonblocking(fd)) {
+                break;
+            }
+            ret = write(fd, rest, count - written);
+        }
+        if (ret >= 0) {
+            written += ret;
+        } else if ((errno != EAGAIN && errno != EWOULDBLOCK) || !wait_io(fd, true)) {
+            break;
+        }
+    }
+    return written > 0 || count == 0 ? (ssize_t) written : -1;
+}
+
+/**
+ * @brief Accepts a connection on the listening socket sockfd like accept(2), parking the calling thread until one
+ * comes (see uthread_read). sockfd is switched to O_NONBLOCK, and the new socket is created non-blocking, ready
+ * for uthread_read and uthread_write.
+ *
+ * @return As accept(2): the new socket, or -1 with errno set.
+*/
+int uthread_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen) {
+    if (!set_nonblocking(sockfd)) {
+        return -1;
+    }
+    while (true) {
+        int fd = accept4(sockfd, addr, addrlen, SOCK_NONBLOCK);
+        if (fd >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK) || !wait_io(sockfd, false)) {
+            return fd;
+        }
+    }
+}
+
+/**
+ * @brief Connects sockfd to addr like connect(2), parking the calling thread until the connection is set up or
+ * fails (see uthread_read). sockfd is switched to O_NONBLOCK.
+ *
+ * @return As connect(2): 0, or -1 with errno set.
+*/
+int uthread_connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen) {
+    if (!set_nonblocking(sockfd)) {
+        return -1;
+    }
+    if (connect(sockfd, addr, addrlen) == 0) {
+        return 0;
+    }
+    if (errno != EINPROGRESS || !wait_io(sockfd, true)) {
+        return -1;
+    }
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &length) < 0) {
+        return -1;
+    }
+    if (error != 0) {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Reads up to count bytes from fd at offset into buf like pread(2), parking the calling thread instead of
+ * blocking the process while the data comes from the disk.
+ *
+ * Data already in the page cache is read at once (preadv2 with RWF_NOWAIT; not on an O_DIRECT descriptor, where
+ * that would still wait for the disk). Otherwise the read goes to the library's io_uring, or to its pool of I/O
+ * kernel threads where io_uring is unavailable; the thread is WAITING (no quantums) until the read completes.
+ * Reads are handed to the kernel in batches, and their completions taken, when no thread is READY and at every
+ * quantum tick. buf must stay valid until the read completes, even if the thread is terminated meanwhile.
+ *
+ * @return As pread(2): the number of bytes read, 0 at end of file, or -1 with errno set.
+*/
+ssize_t uthread_pread(int fd, void *buf, size_t count, off_t offset) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags >= 0 && (flags & O_DIRECT) == 0) {
+        struct iovec iov = {buf, count};
+        ssize_t ret = preadv2(fd, &iov, 1, offset, RWF_NOWAIT);
+        if (ret >= 0) {
+            return ret;
+        }
+        // EAGAIN: not cached; any other error is reported by the real read
+    }
+    return file_request(false, fd, buf, count, offset);
+}
+
+/**
+ * @brief Writes up to count bytes from buf to fd at offset like pwrite(2), parking the calling thread while the
+ * write is in progress (see uthread_pread; writes are not tried at once first).
+ *
+ * @return As pwrite(2): the number of bytes written, or -1 with errno set.
+*/
+ssize_t uthread_pwrite(int fd, const void *buf, size_t count, off_t offset) {
+    return file_request(true, fd, const_cast<void *>(buf), count, offset);
+}
+
+/**
+ * @brief Writes the scheduler events recorded so far to the file path as Chrome trace JSON.
+ *
+ * Only copying the rings keeps the workers out of the scheduler (the lock is held), so no event is torn; they are
+ * merged and written after the library is left. Writing goes through stdio, which needs more stack than
+ * STACK_SIZE: call it from the main thread or from a thread with a larger stack (uthread_spawn_ex). It is an error
+ * if the library was built without -DUTHREADS_TRACE, or if the file cannot be written.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_trace_dump(const char *path) {
+#ifdef UTHREADS_TRACE
+    // sized before the lock is taken, so the copy allocates nothing while the other workers wait
+    std::vector<TraceEvent> snapshot;
+    snapshot.reserve(trace_buffer.capacity());
+    enter_library();
+    trace_buffer.snapshot(snapshot);
+    leave_library();
+    FILE *out = path != nullptr ? fopen(path, "w") : nullptr;
+    bool written = out != nullptr && trace_buffer.write_chrome_json(snapshot, out);
+    if (out == nullptr || fclose(out) != 0 || !written) {
+        std::cout << LIBRARY_ERR << TRACE_FILE_ERR << std::endl;
+        return ERR_CODE;
+    }
+    return EXIT_SUCCESS;
+#else
+    (void) path;
+    enter_library();
+    return library_error_handler(TRACE_DISABLED_ERR);
+#endif
 }
@@ -6,11 +6,42 @@
 #ifndef _UTHREADS_H
 #define _UTHREADS_H
 
-#define MAX_THREAD_NUM 100 /* maximal number of threads */
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#define MAX_THREAD_NUM 100 /* default maximal number of threads */
 #define STACK_SIZE 4096 /* stack size per thread (in bytes) */
+#define UTHREAD_PRIORITIES 8 /* priorities of uthread_set_priority: 0 (the highest) to UTHREAD_PRIORITIES - 1 */
+#define UTHREAD_DEFAULT_WEIGHT 1024 /* weight of a thread for the CFS policy, see uthread_set_weight */
 
 typedef void (*thread_entry_point)(void);
 
+/* Creation attributes for uthread_spawn_ex. */
+typedef struct uthread_attr_t {
+    size_t stack_size; /* stack size in bytes; 0 means STACK_SIZE */
+} uthread_attr_t;
+
+/* Mutex. Initialise with UTHREAD_MUTEX_INITIALIZER or uthread_mutex_init; it must not be copied or moved while
+   in use, since the library keeps the queue of waiting threads inside it. */
+typedef struct uthread_mutex_t {
+    int state;            /* 0: unlocked, 1: locked, 2: locked and threads may be waiting */
+    void *wait_queue[3];  /* opaque, owned by the library */
+} uthread_mutex_t;
+
+#define UTHREAD_MUTEX_INITIALIZER {0, {NULL, NULL, NULL}}
+
+/* Condition variable. Initialise with UTHREAD_COND_INITIALIZER or uthread_cond_init; same rules as the mutex. */
+typedef struct uthread_cond_t {
+    void *wait_queue[3];  /* opaque, owned by the library */
+} uthread_cond_t;
+
+#define UTHREAD_COND_INITIALIZER {{NULL, NULL, NULL}}
+
+/* Bounded channel of fixed-size elements; opaque, see uthread_chan_create. */
+typedef struct uthread_chan_t uthread_chan_t;
+
 /* External interface */
 
 
@@ -21,12 +52,21 @@ typedef void (*thread_entry_point)(void);
  * provide an entry_point or to create a stack for the main thread - it will be using the "regular" stack and PC.
  * You may assume that this function is called before any other thread library function, and that it is called
  * exactly once.
- * The input to the function is the length of a quantum in micro-seconds.
- * It is an error to call this function with non-positive quantum_usecs.
+ * The input to the function is the length of a quantum in micro-seconds, and optionally the maximal number of
+ * concurrent threads (including the main thread); thread control structures grow on demand up to that limit.
+ * num_workers is the number of kernel threads the uthreads run on (typically one per core). With more than one,
+ * each worker has its own quantum timer on the CPU time of its kernel thread. Under the default FIFO policy each
+ * worker also has its own READY queue; spawned and resumed threads are queued on the calling worker, and a worker
+ * that runs out of threads steals the one that waited longest on another worker's queue (see uthread_get_steals).
+ * Under any other policy the workers share one READY queue, in the policy's order.
+ * Quantums of all workers count towards the total (and towards sleeping threads). Blocking or terminating a
+ * thread that is running on another worker takes effect when that worker next enters the scheduler (its next tick
+ * at the latest).
+ * It is an error to call this function with non-positive quantum_usecs, max_threads or num_workers.
  *
  * @return On success, return 0. On failure, return -1.
 */
-int uthread_init(int quantum_usecs);
+int uthread_init(int quantum_usecs, int max_threads = MAX_THREAD_NUM, int num_workers = 1);
 
 /**
  * @brief Creates a new thread, whose entry point is the function entry_point with the signature
@@ -34,7 +74,7 @@ int uthread_init(int quantum_usecs);
  *
  * The thread is added to the end of the READY threads list.
  * The uthread_spawn function should fail if it would cause the number of concurrent threads to exceed the
- * limit (MAX_THREAD_NUM).
+ * limit given to uthread_init (MAX_THREAD_NUM by default).
  * Each thread should be allocated with a stack of size STACK_SIZE bytes.
  * It is an error to call this function with a null entry_point.
  *
@@ -43,6 +83,18 @@ int uthread_init(int quantum_usecs);
 int uthread_spawn(thread_entry_point entry_point);
 
 
+/**
+ * @brief Creates a new thread like uthread_spawn, with the creation attributes in attrs.
+ *
+ * attrs->stack_size selects the stack size (rounded up to whole pages); NULL attrs or a zero size mean STACK_SIZE.
+ * Stacks larger than STACK_SIZE are reserved but not committed: memory is only used for the pages the thread
+ * actually touches (see uthread_get_stack_committed).
+ *
+ * @return On success, return the ID of the created thread. On failure, return -1.
+*/
+int uthread_spawn_ex(thread_entry_point entry_point, const uthread_attr_t *attrs);
+
+
 /**
  * @brief Terminates the thread with ID tid and deletes it from all relevant control structures.
  *
@@ -95,6 +147,59 @@ int uthread_resume(int tid);
 int uthread_sleep(int num_quantums);
 
 
+/**
+ * @brief Blocks the RUNNING thread for usec microseconds of wall-clock time (CLOCK_MONOTONIC).
+ *
+ * Unlike uthread_sleep, the sleep does not depend on how many quantums start meanwhile, nor on whether the process
+ * runs at all: a timer on the monotonic clock, armed for the earliest such deadline only, ticks when it is due
+ * and the thread goes back to the end of the READY queue. While other threads keep the CPU busy, the wake-up comes
+ * at the kernel's next scheduler tick after that. It is an error if usec is negative or if the main thread
+ * (tid == 0) calls this function.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sleep_for(long usec);
+
+
+/**
+ * @brief Blocks the RUNNING thread until the CLOCK_MONOTONIC time *deadline (see uthread_sleep_for). A deadline
+ * that has passed already only gives up the CPU.
+ *
+ * It is an error if deadline is NULL or not a valid time (tv_nsec out of range, or a negative tv_sec), or if the
+ * main thread (tid == 0) calls this function.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_sleep_until(const struct timespec *deadline);
+
+
+/**
+ * @brief Gives up the CPU: the RUNNING thread goes to the end of the READY queue and a scheduling decision is made.
+ *
+ * The switch is done directly in user space, without going through the timer signal. It counts as the start of a
+ * new quantum exactly like a preemption (total quantums, the next thread's quantums and sleeping threads all
+ * advance), and the next thread gets a full quantum. If no other thread is READY the caller keeps running in a
+ * new quantum.
+ *
+ * @return On success, return 0.
+*/
+int uthread_yield();
+
+
+/**
+ * @brief Gives up the CPU to the READY thread with ID tid: it runs right away, ahead of the threads queued before
+ * it, and the RUNNING thread goes to the end of the READY queue.
+ *
+ * Meant for a thread that has just made another one READY (e.g. with uthread_resume) and should hand it the CPU
+ * now rather than after the whole queue. Like uthread_yield it starts a new quantum, which the target gets in
+ * full. If no thread with ID tid exists, or it is not READY (the caller itself is RUNNING), it is considered an
+ * error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_switch_to(int tid);
+
+
 /**
  * @brief Returns the thread ID of the calling thread.
  *
@@ -126,4 +231,360 @@ int uthread_get_total_quantums();
 int uthread_get_quantums(int tid);
 
 
+/**
+ * @brief Returns how many bytes of the stack of the thread with ID tid are committed (backed by memory).
+ *
+ * Stack pages are committed when first touched and stay committed. A stack larger than STACK_SIZE is mapped for
+ * its thread alone, so for it this is the deepest the thread's stack has been so far, rounded to pages. Stacks of
+ * STACK_SIZE are recycled as they are, still committed, from one thread to the next: for them it also counts
+ * the pages earlier owners of the stack touched, up to the whole stack. The main thread runs on the process
+ * stack, which is not tracked: it reports 0. If no thread with ID tid exists it is considered an error.
+ *
+ * @return On success, return the number of committed bytes. On failure, return -1.
+*/
+long uthread_get_stack_committed(int tid);
+
+
+/**
+ * @brief Returns how many times a worker took a READY thread from another worker's run queue.
+ *
+ * With a single worker nothing is ever stolen and this is 0.
+ *
+ * @return The number of steals since uthread_init.
+*/
+long uthread_get_steals();
+
+
+/**
+ * @brief Initializes mutex as unlocked, with no waiting threads.
+ *
+ * It is an error to call this function with a null mutex.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_init(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Locks mutex, waiting for it if another thread holds it.
+ *
+ * Locking a free mutex is a single atomic operation. A thread that has to wait is parked in the mutex's queue: it
+ * is not scheduled (and uses no quantums) until the holder unlocks, and a scheduling decision is made right away.
+ * Blocking a waiting thread keeps it waiting, and it is BLOCKED instead of READY once it gets its turn. The mutex
+ * is not recursive: a thread locking a mutex it holds waits forever. It is an error to call this function with a
+ * null mutex.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_lock(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Locks mutex if it is free, without waiting.
+ *
+ * @return 0 if the mutex was locked by this call, 1 if another thread holds it, -1 on failure (a null mutex).
+*/
+int uthread_mutex_trylock(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Unlocks mutex, which the calling thread must hold, and makes the first thread waiting for it READY.
+ *
+ * Unlocking a mutex nobody waits for is a single atomic operation. It is an error to call this function with a
+ * null mutex or a mutex that is not locked.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_mutex_unlock(uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Initializes cond with no waiting threads.
+ *
+ * It is an error to call this function with a null cond.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_init(uthread_cond_t *cond);
+
+
+/**
+ * @brief Unlocks mutex and waits on cond until another thread signals it, then locks mutex again.
+ *
+ * Unlocking and starting to wait is atomic: a signal sent by a thread that locked mutex after this call released it
+ * is never lost. The waiting thread is parked like a mutex waiter. The condition must be checked again on return,
+ * in a loop. It is an error to call this function with a null cond or mutex, or with a mutex that is not locked.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_wait(uthread_cond_t *cond, uthread_mutex_t *mutex);
+
+
+/**
+ * @brief Makes the first thread waiting on cond READY (BLOCKED if it was blocked meanwhile). Has no effect if no
+ * thread waits on cond.
+ *
+ * It is an error to call this function with a null cond.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_signal(uthread_cond_t *cond);
+
+
+/**
+ * @brief Like uthread_cond_signal, for every thread waiting on cond.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_cond_broadcast(uthread_cond_t *cond);
+
+
+/**
+ * @brief Waits on addr if *addr still equals expected, until another thread calls uthread_wake on addr.
+ *
+ * Checking *addr and starting to wait is atomic with respect to uthread_wake: a thread that changes *addr and then
+ * wakes addr never misses this one. The waiting thread is parked like a mutex waiter (WAITING, no quantums), and
+ * like any such primitive the caller must check its condition again on return. Waiters of an address are woken in
+ * FIFO order. It is an error to call this function with a null addr.
+ *
+ * @return 0 after being woken up, 1 if *addr did not equal expected (the thread did not wait), -1 on failure.
+*/
+int uthread_wait(int *addr, int expected);
+
+
+/**
+ * @brief Wakes up to n threads waiting on addr, the longest-waiting first.
+ *
+ * A woken thread becomes READY, or BLOCKED if it was blocked while waiting. The cost is proportional to the
+ * number of threads woken, not to the number of threads waiting. It is an error to call this function with a
+ * null addr.
+ *
+ * @return On success, return the number of threads woken up. On failure, return -1.
+*/
+int uthread_wake(int *addr, int n);
+
+
+/**
+ * @brief Creates a channel carrying elements of elem_size bytes, buffering up to capacity of them.
+ *
+ * With capacity 0 the channel is unbuffered: every send waits for a receiver and the other way around. It is an
+ * error to call this function with a zero elem_size or a negative capacity.
+ *
+ * @return On success, return the channel. On failure, return NULL.
+*/
+uthread_chan_t *uthread_chan_create(size_t elem_size, int capacity);
+
+
+/**
+ * @brief Destroys chan, dropping the elements still buffered in it.
+ *
+ * It is an error to call this function with a null chan or while threads wait on it.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_chan_destroy(uthread_chan_t *chan);
+
+
+/**
+ * @brief Sends a copy of the element at elem on chan, waiting while the channel is full.
+ *
+ * A receiver waiting on the channel gets the element directly, without going through the buffer, and runs next
+ * on this worker if the sender itself waits right after. A waiting sender is parked like a mutex waiter (WAITING,
+ * no quantums) and its element is taken directly from elem. Elements are received in the order they were sent.
+ * It is an error to call this function with a null chan or elem.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_chan_send(uthread_chan_t *chan, const void *elem);
+
+
+/**
+ * @brief Receives the oldest element of chan into elem, waiting while the channel is empty.
+ *
+ * Like uthread_chan_send, a waiting receiver is parked and gets its element copied directly into elem. It is an
+ * error to call this function with a null chan or elem.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_chan_recv(uthread_chan_t *chan, void *elem);
+
+
+/**
+ * @brief Sends like uthread_chan_send if that needs no waiting.
+ *
+ * @return 0 if the element was sent, 1 if the channel is full (nothing was sent), -1 on failure.
+*/
+int uthread_chan_try_send(uthread_chan_t *chan, const void *elem);
+
+
+/**
+ * @brief Receives like uthread_chan_recv if that needs no waiting.
+ *
+ * @return 0 if an element was received, 1 if the channel is empty (elem is untouched), -1 on failure.
+*/
+int uthread_chan_try_recv(uthread_chan_t *chan, void *elem);
+
+
+/**
+ * @brief Sets the priority of the thread with ID tid: 0 is the highest, UTHREAD_PRIORITIES - 1 the lowest.
+ *
+ * Threads start with priority 0. Only the MLFQ policy (built with -DUTHREADS_POLICY=MlfqPolicy) schedules by
+ * priority: a thread starts at the level of its priority, sinks a level for every quantum it uses up, rises back
+ * a level (never above its priority) whenever it gives up the CPU before the end of its quantum, and returns to
+ * its priority's level every MLFQ_BOOST_QUANTUMS quantums so that CPU-bound threads cannot starve. The other
+ * policies keep the priority but ignore it. If no thread with ID tid exists or prio is out of range, it is
+ * considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_priority(int tid, int prio);
+
+
+/**
+ * @brief Returns how long the thread with ID tid has run, in nanoseconds.
+ *
+ * The time is measured at every switch (on the monotonic clock), so a thread that gives up the CPU right after
+ * being switched in is only charged for that moment, not for a quantum. For a RUNNING thread it includes the time
+ * up to this call. If no thread with ID tid exists it is considered an error.
+ *
+ * @return On success, return the run time of the thread with ID tid. On failure, return -1.
+*/
+long uthread_get_runtime(int tid);
+
+
+/**
+ * @brief Sets the weight of the thread with ID tid: its share of the CPU under the CFS policy.
+ *
+ * Threads start with weight UTHREAD_DEFAULT_WEIGHT. Under the CFS policy (built with -DUTHREADS_POLICY=CfsPolicy)
+ * the READY thread that has run least, in run time divided by weight, runs next, so threads that are always READY
+ * share the CPU in proportion to their weights. The other policies keep the weight but ignore it. If no thread
+ * with ID tid exists or weight is not positive, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_weight(int tid, int weight);
+
+
+/**
+ * @brief Makes the thread with ID tid a real-time thread that runs periodic jobs: one job every period_us
+ * microseconds, each due by the end of its period and entitled to budget_us microseconds of CPU.
+ *
+ * The first job is released now. A job ends when the thread calls uthread_wait_period, which sleeps until the
+ * next release; a job that ends after its deadline counts as a deadline miss (uthread_get_deadline_misses). Under
+ * the EDF policy (built with -DUTHREADS_POLICY=EdfPolicy) the READY job with the earliest deadline runs first, for
+ * at most its budget; after that it only runs, in FIFO order with the ordinary threads, while no job with budget
+ * left is READY. The other policies keep the parameters but ignore them; jobs, releases and misses work the same.
+ * A period_us of 0 makes the thread an ordinary thread again (budget_us is then ignored). If no thread with ID tid
+ * exists, or budget_us is not between 1 and period_us, it is considered an error.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_set_deadline(int tid, int period_us, int budget_us);
+
+
+/**
+ * @brief Ends the current job of the calling real-time thread and sleeps until its next job is released.
+ *
+ * That is the end of the job's period if the job ended in time. A late job counts as a deadline miss, and the
+ * next job is released at the first period boundary after now: the releases the late job overran are skipped. The
+ * sleep is on the monotonic clock, not in quantums. It is an error if the calling thread has no deadline (see
+ * uthread_set_deadline) or is the main thread (tid == 0).
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_wait_period();
+
+
+/**
+ * @brief Returns how many jobs of the thread with ID tid ended after their deadline.
+ *
+ * If no thread with ID tid exists it is considered an error.
+ *
+ * @return On success, return the number of deadline misses of the thread with ID tid. On failure, return -1.
+*/
+long uthread_get_deadline_misses(int tid);
+
+
+/**
+ * @brief Reads up to count bytes from fd into buf like read(2), parking the calling thread instead of blocking
+ * the process while there is nothing to read.
+ *
+ * A parked thread is WAITING (no quantums) until the scheduler's epoll reactor finds fd readable: the reactor is
+ * polled whenever no thread is READY, at every quantum tick, and by an idle worker that sleeps on it. Sockets are
+ * read with MSG_DONTWAIT; any other descriptor is switched to O_NONBLOCK (and left so). A regular file, which
+ * epoll cannot watch, is read as by read(2).
+ *
+ * @return As read(2): the number of bytes read, 0 at end of file, or -1 with errno set.
+*/
+ssize_t uthread_read(int fd, void *buf, size_t count);
+
+
+/**
+ * @brief Writes the count bytes at buf to fd like a blocking write(2), parking the calling thread while fd is
+ * full (see uthread_read).
+ *
+ * @return The number of bytes written, count unless an error stopped it early; -1 with errno set if nothing was
+ * written.
+*/
+ssize_t uthread_write(int fd, const void *buf, size_t count);
+
+
+/**
+ * @brief Accepts a connection on the listening socket sockfd like accept(2), parking the calling thread until one
+ * comes (see uthread_read). sockfd is switched to O_NONBLOCK, and the new socket is created non-blocking, ready
+ * for uthread_read and uthread_write.
+ *
+ * @return As accept(2): the new socket, or -1 with errno set.
+*/
+int uthread_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen);
+
+
+/**
+ * @brief Connects sockfd to addr like connect(2), parking the calling thread until the connection is set up or
+ * fails (see uthread_read). sockfd is switched to O_NONBLOCK.
+ *
+ * @return As connect(2): 0, or -1 with errno set.
+*/
+int uthread_connect(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
+
+
+/**
+ * @brief Reads up to count bytes from fd at offset into buf like pread(2), parking the calling thread instead of
+ * blocking the process while the data comes from the disk.
+ *
+ * Data already in the page cache is read at once (preadv2 with RWF_NOWAIT; not on an O_DIRECT descriptor, where
+ * that would still wait for the disk). Otherwise the read goes to the library's io_uring, or to its pool of I/O
+ * kernel threads where io_uring is unavailable; the thread is WAITING (no quantums) until the read completes.
+ * Reads are handed to the kernel in batches, and their completions taken, when no thread is READY and at every
+ * quantum tick. buf must stay valid until the read completes, even if the thread is terminated meanwhile.
+ *
+ * @return As pread(2): the number of bytes read, 0 at end of file, or -1 with errno set.
+*/
+ssize_t uthread_pread(int fd, void *buf, size_t count, off_t offset);
+
+
+/**
+ * @brief Writes up to count bytes from buf to fd at offset like pwrite(2), parking the calling thread while the
+ * write is in progress (see uthread_pread; writes are not tried at once first).
+ *
+ * @return As pwrite(2): the number of bytes written, or -1 with errno set.
+*/
+ssize_t uthread_pwrite(int fd, const void *buf, size_t count, off_t offset);
+
+
+/**
+ * @brief Writes the latest scheduler events to the file path as Chrome trace JSON (chrome://tracing,
+ * ui.perfetto.dev): a track per thread with the slices it ran for, and its spawn, block, resume, sleep, wake and
+ * terminate events.
+ *
+ * Events are only recorded by a library built with -DUTHREADS_TRACE, into a ring per worker keeping its last
+ * UTHREADS_TRACE_EVENTS (65536 by default), timed on the TSC; otherwise this function is an error. The JSON is
+ * written with stdio, so call it from the main thread or from a thread with a stack larger than STACK_SIZE.
+ *
+ * @return On success, return 0. On failure, return -1.
+*/
+int uthread_trace_dump(const char *path);
+
+
+
 #endif